@@ -0,0 +1,570 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include "./header/lexer.h"
+#include "./header/parser.h"
+#include "./header/evaluator.h"
+#include "./header/resolver.h"
+#include "./header/compiler.h"
+#include "./header/vm.h"
+#include "./header/optimizer.h"
+
+// micro benchmarks, build with:
+// g++ -std=c++11 -O2 bench.cpp src/*.cpp -o bench
+
+// the loop of minFactor in test.mk, on a prime so that it runs to the end.
+const std::string MIN_FACTOR =
+    "let minFactor = fn (a) {\n"
+    "  let i = 2;\n"
+    "  while(true) {\n"
+    "    if (a % i == 0) {\n"
+    "      return i;\n"
+    "    }\n"
+    "    let i = i + 1;\n"
+    "  }\n"
+    "}\n"
+    "minFactor(200003);\n";
+
+// string literals in a loop body, only the concatenation has to allocate.
+const std::string CONCAT =
+    "let concat = fn (n) {\n"
+    "  let i = 0;\n"
+    "  while(i < n) {\n"
+    "    let s = \"mon\" + \"key\";\n"
+    "    let i = i + 1;\n"
+    "  }\n"
+    "}\n"
+    "concat(100000);\n";
+
+// a call for every step, each with its own environment
+const std::string FIB =
+    "let fib = fn (n) {\n"
+    "  if (n < 2) { return n; }\n"
+    "  let a = fib(n - 1);\n"
+    "  let b = fib(n - 2);\n"
+    "  a + b\n"
+    "}\n"
+    "fib(24);\n";
+
+// constant expressions and a constant condition in a loop body,
+// the optimizer folds them before the loop runs.
+const std::string CONSTANTS =
+    "let constants = fn (n) {\n"
+    "  let i = 0;\n"
+    "  let t = 0;\n"
+    "  while(i < n) {\n"
+    "    if (true) { let t = t + 60 * 60 * 24 - (2 * 3 + 1) * 1000; }\n"
+    "    if (1 > 2) { let t = 0; }\n"
+    "    let i = i + 1;\n"
+    "  }\n"
+    "  t\n"
+    "}\n"
+    "constants(100000);\n";
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// the tokens point into input, which has to outlive the program
+monkey::Program* parse(const std::string& input) {
+  monkey::Lexer l;
+  monkey::Parser p;
+  l.New(input);
+  p.New(l);
+  return p.ParseProgram();
+}
+
+/*
+ * node dispatch
+ * visit every node of the program the way Evaluator::Eval dispatches,
+ * once with the old Type() string compares and once with Kind().
+ */
+std::vector<monkey::Node*> collectNodes(monkey::Program* program) {
+  std::vector<monkey::Node*> nodes;
+  std::vector<monkey::Node*> todo(program->statements.begin(), program->statements.end());
+  while (!todo.empty()) {
+    monkey::Node* node = todo.back();
+    todo.pop_back();
+    if (node == nullptr)
+      continue;
+    nodes.push_back(node);
+    switch (node->Kind()) {
+    case monkey::LET_STATEMENT_NODE:
+      todo.push_back(((monkey::LetStatement*)node)->value);
+      break;
+    case monkey::RETURN_STATEMENT_NODE:
+      todo.push_back(((monkey::ReturnStatement*)node)->returnValue);
+      break;
+    case monkey::EXPRESSION_STATEMENT_NODE:
+      todo.push_back(((monkey::ExpressionStatement*)node)->expression);
+      break;
+    case monkey::BLOCK_STATEMENT_NODE:
+      for (auto stmt : ((monkey::BlockStatement*)node)->statements)
+        todo.push_back(stmt);
+      break;
+    case monkey::FUNCTION_LITERAL_NODE:
+      todo.push_back(((monkey::FunctionLiteral*)node)->body);
+      break;
+    case monkey::CALL_EXPRESSION_NODE:
+      todo.push_back(((monkey::CallExpression*)node)->function);
+      for (auto arg : ((monkey::CallExpression*)node)->arguments)
+        todo.push_back(arg);
+      break;
+    case monkey::INFIX_EXPRESSION_NODE:
+      todo.push_back(((monkey::InfixExpression*)node)->left);
+      todo.push_back(((monkey::InfixExpression*)node)->right);
+      break;
+    case monkey::IF_EXPRESSION_NODE:
+      todo.push_back(((monkey::IfExpression*)node)->condition);
+      todo.push_back(((monkey::IfExpression*)node)->consequence);
+      todo.push_back(((monkey::IfExpression*)node)->alternative);
+      break;
+    case monkey::WHILE_EXPRESSION_NODE:
+      todo.push_back(((monkey::WhileExpression*)node)->condition);
+      todo.push_back(((monkey::WhileExpression*)node)->consequence);
+      break;
+    default:
+      break;
+    }
+  }
+  return nodes;
+}
+
+// the chain Eval used before NodeKind, in the same order
+int dispatchByString(monkey::Node* node) {
+  std::string type = node->Type();
+  if (type == "Program") return 0;
+  else if (type == "IntegerLiteral") return 1;
+  else if (type == "BooleanLiteral") return 2;
+  else if (type == "StringLiteral") return 3;
+  else if (type == "Identifier") return 4;
+  else if (type == "FunctionLiteral") return 5;
+  else if (type == "CallExpression") return 6;
+  else if (type == "IndexExpression") return 7;
+  else if (type == "ArrayLiteral") return 8;
+  else if (type == "PrefixExpression") return 9;
+  else if (type == "InfixExpression") return 10;
+  else if (type == "IfExpression") return 11;
+  else if (type == "WhileExpression") return 12;
+  else if (type == "ExpressionStatement") return 13;
+  else if (type == "BlockStatement") return 14;
+  else if (type == "ReturnStatement") return 15;
+  else if (type == "LetStatement") return 16;
+  else if (type == "RefStatement") return 17;
+  else if (type == "HashLiteral") return 18;
+  return -1;
+}
+
+int dispatchByKind(monkey::Node* node) {
+  switch (node->Kind()) {
+  case monkey::PROGRAM_NODE: return 0;
+  case monkey::INTEGER_LITERAL_NODE: return 1;
+  case monkey::BOOLEAN_LITERAL_NODE: return 2;
+  case monkey::STRING_LITERAL_NODE: return 3;
+  case monkey::IDENTIFIER_NODE: return 4;
+  case monkey::FUNCTION_LITERAL_NODE: return 5;
+  case monkey::CALL_EXPRESSION_NODE: return 6;
+  case monkey::INDEX_EXPRESSION_NODE: return 7;
+  case monkey::ARRAY_LITERAL_NODE: return 8;
+  case monkey::PREFIX_EXPRESSION_NODE: return 9;
+  case monkey::INFIX_EXPRESSION_NODE: return 10;
+  case monkey::IF_EXPRESSION_NODE: return 11;
+  case monkey::WHILE_EXPRESSION_NODE: return 12;
+  case monkey::EXPRESSION_STATEMENT_NODE: return 13;
+  case monkey::BLOCK_STATEMENT_NODE: return 14;
+  case monkey::RETURN_STATEMENT_NODE: return 15;
+  case monkey::LET_STATEMENT_NODE: return 16;
+  case monkey::REF_STATEMENT_NODE: return 17;
+  case monkey::HASH_LITERAL_NODE: return 18;
+  }
+  return -1;
+}
+
+void benchDispatch(int rounds) {
+  monkey::Program* program = parse(MIN_FACTOR);
+  std::vector<monkey::Node*> nodes = collectNodes(program);
+  long checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+    for (auto node : nodes)
+      checksum += dispatchByString(node);
+  double byString = elapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+    for (auto node : nodes)
+      checksum += dispatchByKind(node);
+  double byKind = elapsedMs(start);
+
+  long dispatches = (long)rounds * nodes.size();
+  std::cout << "dispatch (" << dispatches << " nodes)" << std::endl;
+  std::cout << "  Type() string compares: " << byString << " ms" << std::endl;
+  std::cout << "  Kind() switch:          " << byKind << " ms" << std::endl;
+  std::cout << "  (checksum " << checksum << ")" << std::endl;
+  delete program;
+}
+
+void benchEval(int rounds) {
+  monkey::Program* program = parse(MIN_FACTOR);
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+  double total = 0;
+  for (int r = 0; r < rounds; r++) {
+    monkey::Evaluator e;
+    monkey::Environment* env = new monkey::Environment(resolver.Globals());
+    auto start = std::chrono::steady_clock::now();
+    e.Eval(program, env);
+    total += elapsedMs(start);
+  }
+  std::cout << "eval minFactor(200003): " << total / rounds << " ms/run" << std::endl;
+}
+
+void benchVM(int rounds) {
+  monkey::Program* program = parse(MIN_FACTOR);
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+  monkey::Compiler c;
+  c.Compile(program);
+  double total = 0;
+  for (int r = 0; r < rounds; r++) {
+    monkey::VM vm(c.GetBytecode());
+    monkey::Environment* env = new monkey::Environment(resolver.Globals());
+    auto start = std::chrono::steady_clock::now();
+    vm.Run(env);
+    total += elapsedMs(start);
+  }
+  std::cout << "vm   minFactor(200003): " << total / rounds << " ms/run" << std::endl;
+}
+
+/*
+ * calls
+ * the FIB recursion on both backends, dominated by setting up calls.
+ */
+void benchCalls(int rounds) {
+  monkey::Program* program = parse(FIB);
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+  monkey::Compiler c;
+  c.Compile(program);
+  double evalMs = 0, vmMs = 0;
+  for (int r = 0; r < rounds; r++) {
+    monkey::Evaluator e;
+    auto start = std::chrono::steady_clock::now();
+    e.Eval(program, new monkey::Environment(resolver.Globals()));
+    evalMs += elapsedMs(start);
+    monkey::VM vm(c.GetBytecode());
+    start = std::chrono::steady_clock::now();
+    vm.Run(new monkey::Environment(resolver.Globals()));
+    vmMs += elapsedMs(start);
+  }
+  std::cout << "calls fib(24)" << std::endl;
+  std::cout << "  eval: " << evalMs / rounds << " ms/run" << std::endl;
+  std::cout << "  vm:   " << vmMs / rounds << " ms/run" << std::endl;
+  delete program;
+}
+
+/*
+ * optimizer
+ * the CONSTANTS loop evaluated as written and after the optimizer.
+ */
+double evalConstants(bool optimize, int rounds) {
+  monkey::Program* program = parse(CONSTANTS);
+  if (optimize) {
+    monkey::Optimizer opt;
+    opt.Optimize(program);
+  }
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+  double total = 0;
+  for (int r = 0; r < rounds; r++) {
+    monkey::Evaluator e;
+    monkey::Environment* env = new monkey::Environment(resolver.Globals());
+    auto start = std::chrono::steady_clock::now();
+    e.Eval(program, env);
+    total += elapsedMs(start);
+  }
+  delete program;
+  return total / rounds;
+}
+
+void benchOptimize(int rounds) {
+  std::cout << "eval constants(100000)" << std::endl;
+  std::cout << "  as written: " << evalConstants(false, rounds) << " ms/run" << std::endl;
+  std::cout << "  optimized:  " << evalConstants(true, rounds) << " ms/run" << std::endl;
+}
+
+/*
+ * parsing
+ * a synthetic corpus with every kind of expression,
+ * lexed, parsed and freed again.
+ */
+const std::string CORPUS =
+    "let fib = fn (n) { if (n < 2) { return n; } else { return fib(n - 1) + fib(n - 2); } }\n"
+    "let names = [\"ada\", \"grace\", \"barbara\", \"frances\"];\n"
+    "let total = 0;\n"
+    "let i = 0;\n"
+    "while (i < 10) { let total = total + fib(i) * (i % 3) - -i; let i = i + 1; }\n"
+    "let pick = fn (a, k) { a[k % 4] }\n"
+    "print(pick(names, total), !true == false, total >= 100, [1, [2, 3]][1][0]);\n"
+    "&total = total / 2;\n";
+
+double mbPerSecond(size_t bytes, double ms) {
+  return bytes / (1024.0 * 1024.0) / (ms / 1000.0);
+}
+
+void benchParse(int copies) {
+  std::string input;
+  for (int i = 0; i < copies; i++)
+    input += CORPUS;
+  auto start = std::chrono::steady_clock::now();
+  monkey::Lexer l;
+  l.New(input);
+  long tokens = 0;
+  for (monkey::Token t = l.NextToken(); t.type != monkey::END; t = l.NextToken())
+    tokens++;
+  double lexMs = elapsedMs(start);
+  start = std::chrono::steady_clock::now();
+  monkey::Program* program = parse(input);
+  double parseMs = elapsedMs(start);
+  start = std::chrono::steady_clock::now();
+  delete program;
+  double freeMs = elapsedMs(start);
+  std::cout << "corpus " << input.size() / 1024 << " KB, " << tokens << " tokens" << std::endl;
+  std::cout << "  lex:   " << lexMs << " ms, " << mbPerSecond(input.size(), lexMs) << " MB/s" << std::endl;
+  std::cout << "  parse: " << parseMs << " ms, " << mbPerSecond(input.size(), parseMs) << " MB/s" << std::endl;
+  std::cout << "  free:  " << freeMs << " ms" << std::endl;
+}
+
+/*
+ * allocations
+ * heap objects created for the CONCAT loop by each backend.
+ */
+void benchAllocations() {
+  monkey::Program* program = parse(CONCAT);
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+
+  monkey::Evaluator e;
+  auto start = std::chrono::steady_clock::now();
+  e.Eval(program, new monkey::Environment(resolver.Globals()));
+  double evalMs = elapsedMs(start);
+
+  monkey::Compiler c;
+  c.Compile(program);
+  monkey::VM vm(c.GetBytecode());
+  start = std::chrono::steady_clock::now();
+  vm.Run(new monkey::Environment(resolver.Globals()));
+  double vmMs = elapsedMs(start);
+
+  std::cout << "allocations concat(100000)" << std::endl;
+  std::cout << "  eval: " << e.Allocations() << " objects, " << evalMs << " ms" << std::endl;
+  std::cout << e.Stats().String();
+  std::cout << "  vm:   " << vm.Allocations() << " objects, " << vmMs << " ms" << std::endl;
+  std::cout << vm.Stats().String();
+}
+
+/*
+ * lookups
+ * finding a value by its key, in two parallel arrays with a linear
+ * scan and in a hash.
+ */
+const int LOOKUP_KEYS = 200;
+
+// the keys are multiples of 7, the values count up
+std::string lookupProgram(bool hash) {
+  std::string keys, values, pairs;
+  for (int i = 0; i < LOOKUP_KEYS; i++) {
+    std::string sep = i > 0 ? ", " : "";
+    keys += sep + std::to_string(i * 7);
+    values += sep + std::to_string(i);
+    pairs += sep + std::to_string(i * 7) + ": " + std::to_string(i);
+  }
+  std::string n = std::to_string(LOOKUP_KEYS);
+  std::string find = hash ?
+      "let table = {" + pairs + "};\n"
+      "let find = fn (k) { table[k] }\n" :
+      "let ks = [" + keys + "];\n"
+      "let vs = [" + values + "];\n"
+      "let find = fn (k) {\n"
+      "  let i = 0;\n"
+      "  while (i < " + n + ") {\n"
+      "    if (ks[i] == k) { return vs[i]; }\n"
+      "    let i = i + 1;\n"
+      "  }\n"
+      "}\n";
+  return find +
+      "let lookups = fn (n) {\n"
+      "  let j = 0;\n"
+      "  let t = 0;\n"
+      "  while (j < n) {\n"
+      "    let t = t + find(j % " + n + " * 7);\n"
+      "    let j = j + 1;\n"
+      "  }\n"
+      "  t\n"
+      "}\n"
+      "lookups(2000);\n";
+}
+
+// average time of a whole program on one backend
+double runMs(const std::string& input, bool vm, int rounds) {
+  monkey::Program* program = parse(input);
+  monkey::Resolver resolver;
+  resolver.Resolve(program);
+  monkey::Compiler c;
+  if (vm)
+    c.Compile(program);
+  double total = 0;
+  for (int r = 0; r < rounds; r++) {
+    auto start = std::chrono::steady_clock::now();
+    if (vm) {
+      monkey::VM machine(c.GetBytecode());
+      machine.Run(new monkey::Environment(resolver.Globals()));
+    } else {
+      monkey::Evaluator e;
+      e.Eval(program, new monkey::Environment(resolver.Globals()));
+    }
+    total += elapsedMs(start);
+  }
+  delete program;
+  return total / rounds;
+}
+
+void benchLookup(int rounds) {
+  std::string arrays = lookupProgram(false);
+  std::string hash = lookupProgram(true);
+  std::cout << "lookups(2000) in " << LOOKUP_KEYS << " keys" << std::endl;
+  std::cout << "  eval arrays: " << runMs(arrays, false, rounds) << " ms/run" << std::endl;
+  std::cout << "  eval hash:   " << runMs(hash, false, rounds) << " ms/run" << std::endl;
+  std::cout << "  vm arrays:   " << runMs(arrays, true, rounds) << " ms/run" << std::endl;
+  std::cout << "  vm hash:     " << runMs(hash, true, rounds) << " ms/run" << std::endl;
+}
+
+/*
+ * indexing
+ * a loop over every element of an array and every character of a
+ * string, each as long as the loop.
+ */
+std::string indexProgram(int n) {
+  std::string elements;
+  for (int i = 0; i < n; i++)
+    elements += (i > 0 ? ", " : "") + std::to_string(i);
+  return "let a = [" + elements + "];\n"
+      "let s = \"" + std::string(n, 'x') + "\";\n"
+      "let scan = fn (arr, str, n) {\n"
+      "  let i = 0;\n"
+      "  let t = 0;\n"
+      "  while (i < n) {\n"
+      "    let t = t + arr[i];\n"
+      "    let c = str[i];\n"
+      "    let i = i + 1;\n"
+      "  }\n"
+      "  t\n"
+      "}\n"
+      "scan(a, s, " + std::to_string(n) + ");\n";
+}
+
+void benchIndex(int rounds) {
+  std::string input = indexProgram(20000);
+  std::cout << "index scan(20000)" << std::endl;
+  std::cout << "  eval: " << runMs(input, false, rounds) << " ms/run" << std::endl;
+  std::cout << "  vm:   " << runMs(input, true, rounds) << " ms/run" << std::endl;
+}
+
+/*
+ * indexed assignment
+ * a sieve of eratosthenes that clears the flags of an array in place.
+ */
+std::string sieveProgram(int n) {
+  std::string flags;
+  for (int i = 0; i < n; i++)
+    flags += i > 0 ? ", true" : "true";
+  return "let flags = [" + flags + "];\n"
+      "let sieve = fn (n) {\n"
+      "  let i = 2;\n"
+      "  while (i * i < n) {\n"
+      "    if (flags[i]) {\n"
+      "      let j = i * i;\n"
+      "      while (j < n) { &flags[j] = false; let j = j + i; }\n"
+      "    }\n"
+      "    let i = i + 1;\n"
+      "  }\n"
+      "}\n"
+      "sieve(" + std::to_string(n) + ");\n";
+}
+
+void benchSieve(int rounds) {
+  std::string input = sieveProgram(100000);
+  std::cout << "sieve(100000)" << std::endl;
+  std::cout << "  eval: " << runMs(input, false, rounds) << " ms/run" << std::endl;
+  std::cout << "  vm:   " << runMs(input, true, rounds) << " ms/run" << std::endl;
+}
+
+/*
+ * growing arrays
+ * push grows the array in place, concat appends past the range of acc
+ * that no other array sees, so both loops are linear.
+ */
+std::string buildProgram(int n) {
+  return
+      "let build = fn(n) {\n"
+      "  let acc = [];\n"
+      "  let i = 0;\n"
+      "  while (i < n) { push(acc, i); let i = i + 1; }\n"
+      "  acc\n"
+      "};\n"
+      "let join = fn(n) {\n"
+      "  let acc = [];\n"
+      "  let i = 0;\n"
+      "  while (i < n) { let acc = concat(acc, [i]); let i = i + 1; }\n"
+      "  acc\n"
+      "};\n"
+      "len(build(" + std::to_string(n) + ")) + len(join(" + std::to_string(n) + "));\n";
+}
+
+void benchBuild(int rounds) {
+  std::string input = buildProgram(100000);
+  std::cout << "push and concat 100000" << std::endl;
+  std::cout << "  eval: " << runMs(input, false, rounds) << " ms/run" << std::endl;
+  std::cout << "  vm:   " << runMs(input, true, rounds) << " ms/run" << std::endl;
+}
+
+// every element is an array of its own, so the collections have to keep
+// up with an old array that holds more and more young objects. four
+// times the elements should take about four times as long.
+std::string pushObjectsProgram(int n) {
+  return
+      "let build = fn(n) {\n"
+      "  let acc = [];\n"
+      "  let i = 0;\n"
+      "  while (i < n) { push(acc, [i]); let i = i + 1; }\n"
+      "  acc\n"
+      "};\n"
+      "len(build(" + std::to_string(n) + "));\n";
+}
+
+void benchPushObjects(int rounds) {
+  for (int n : {250000, 1000000}) {
+    std::string input = pushObjectsProgram(n);
+    std::cout << "push [i] " << n << std::endl;
+    std::cout << "  eval: " << runMs(input, false, rounds) << " ms/run" << std::endl;
+    std::cout << "  vm:   " << runMs(input, true, rounds) << " ms/run" << std::endl;
+  }
+}
+
+int main() {
+  benchDispatch(200000);
+  benchEval(5);
+  benchVM(5);
+  benchCalls(5);
+  benchOptimize(5);
+  benchParse(10000);
+  benchAllocations();
+  benchLookup(5);
+  benchIndex(5);
+  benchSieve(5);
+  benchBuild(5);
+  benchPushObjects(3);
+  return 0;
+}
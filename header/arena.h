@@ -0,0 +1,71 @@
+#ifndef MONKEY_ARENA_H_
+#define MONKEY_ARENA_H_
+
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+namespace monkey {
+
+class Node;
+
+// chunks double from the first size up to the largest one, a streamed
+// statement is usually small and its arena may be kept by a function.
+const size_t ARENA_FIRST_CHUNK_SIZE = 512;
+const size_t ARENA_CHUNK_SIZE = 16 * 1024;
+
+// bump allocator for the nodes of one Program.
+// nodes are never deleted one by one, the arena runs their destructors
+// and releases all of its chunks at once when the last reference is gone.
+// the Program holds one reference, and so does every Function object made
+// from one of its FunctionLiterals, so a function outlives a streamed statement.
+class Arena {
+ public:
+  Arena() : current(nullptr), left(0), bytes(0), refs(1) { }
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena();
+
+  void Retain() { refs++; }
+  void Release() {
+    if (--refs == 0)
+      delete this;
+  }
+
+  template <typename T>
+  T* New() {
+    T* node = new (allocate(sizeof(T))) T();
+    nodes.push_back(node);
+    return node;
+  }
+
+  size_t Bytes() { return bytes; }
+
+ private:
+  void* allocate(size_t size) {
+    size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    if (size > left) {
+      size_t chunk = chunks.empty() ? ARENA_FIRST_CHUNK_SIZE : std::min(bytes, ARENA_CHUNK_SIZE);
+      current = (char*)::operator new(chunk);
+      chunks.push_back(current);
+      left = chunk;
+      bytes += chunk;
+    }
+    void* p = current;
+    current += size;
+    left -= size;
+    return p;
+  }
+
+  std::vector<char*> chunks;
+  char* current;  // the free part of the last chunk
+  size_t left;
+  size_t bytes;  // of all the chunks
+  long refs;
+  std::vector<Node*> nodes;  // to run the destructors
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_ARENA_H_
@@ -2,9 +2,47 @@
 #define MONKEY_AST_H_
 #include <string>
 #include <vector>
+#include <utility>
 #include "token.h"
+#include "arena.h"
 
 namespace monkey {
+
+class Scope;
+class Object;
+
+// compact tag for every concrete node, so that the evaluator can
+// dispatch with a switch instead of comparing Type() strings.
+enum NodeKind {
+  PROGRAM_NODE,
+  IDENTIFIER_NODE,
+  INTEGER_LITERAL_NODE,
+  BOOLEAN_LITERAL_NODE,
+  STRING_LITERAL_NODE,
+  FUNCTION_LITERAL_NODE,
+  ARRAY_LITERAL_NODE,
+  HASH_LITERAL_NODE,
+  CALL_EXPRESSION_NODE,
+  INDEX_EXPRESSION_NODE,
+  PREFIX_EXPRESSION_NODE,
+  INFIX_EXPRESSION_NODE,
+  IF_EXPRESSION_NODE,
+  WHILE_EXPRESSION_NODE,
+  LET_STATEMENT_NODE,
+  REF_STATEMENT_NODE,
+  RETURN_STATEMENT_NODE,
+  EXPRESSION_STATEMENT_NODE,
+  BLOCK_STATEMENT_NODE,
+};
+
+// where the Resolver found the variable an Identifier names
+enum VariableKind {
+  GLOBAL_VARIABLE,   // slot of the top level Environment
+  LOCAL_VARIABLE,    // slot of the Environment of the call
+  CELL_VARIABLE,     // slot of the call holding the Cell a closure captured
+  UPVALUE_VARIABLE,  // slot is an index into the upvalues of the running closure
+};
+
 /*
  * Interfaces
  * use pure class to imitate interface.
@@ -15,6 +53,7 @@ class Node {
   virtual std::string TokenLiteral() = 0;
   virtual std::string String() = 0;
   virtual std::string Type() = 0;
+  virtual NodeKind Kind() = 0;
 };
 
 // here I haven't found any good solution to nesting interface.
@@ -24,6 +63,7 @@ class Statement : public Node {
   virtual std::string TokenLiteral() = 0;
   virtual std::string String() = 0;
   virtual std::string Type() = 0;
+  virtual NodeKind Kind() = 0;
 };
 
 class Expression : public Node {
@@ -31,23 +71,25 @@ class Expression : public Node {
   virtual std::string TokenLiteral() = 0;
   virtual std::string String() = 0;
   virtual std::string Type() = 0;
+  virtual NodeKind Kind() = 0;
 };
 
 /*
  * Whole Program
+ * every other node is allocated in the arena of its Program,
+ * so nodes do not delete their children.
  */
 class Program : public Node {
  public:
-  ~Program() {
-    for(auto stmt : statements) {
-      delete stmt;
-    }
-  }
+  Program() : arena(new Arena()) { }
+  ~Program() { arena->Release(); }
   std::string TokenLiteral();
   std::string String();
   std::string Type() { return "Program"; }
+  NodeKind Kind() { return PROGRAM_NODE; }
 
   std::vector<Statement*> statements;  
+  Arena* arena;
 };
 
 /*
@@ -60,9 +102,13 @@ class Identifier : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String() { return value; }
   std::string Type() { return "Identifier"; }
+  NodeKind Kind() { return IDENTIFIER_NODE; }
   
   Token token;
   std::string value;
+  // set by the Resolver
+  VariableKind kind = GLOBAL_VARIABLE;
+  int slot = -1;
 };
 
 class IntegerLiteral : public Expression {
@@ -70,6 +116,7 @@ class IntegerLiteral : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String() { return std::to_string(value); }
   std::string Type() { return "IntegerLiteral"; }
+  NodeKind Kind() { return INTEGER_LITERAL_NODE; }
   
   Token token;
   int value;
@@ -80,6 +127,7 @@ class BooleanLiteral : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String() { return value ? "true" : "false"; }
   std::string Type() { return "BooleanLiteral"; }
+  NodeKind Kind() { return BOOLEAN_LITERAL_NODE; }
   
   Token token;
   bool value;
@@ -90,56 +138,58 @@ class StringLiteral : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String() { return value; }
   std::string Type() { return "StringLiteral"; }
+  NodeKind Kind() { return STRING_LITERAL_NODE; }
 
   Token token;
   std::string value;
+  Object* constant = nullptr;  // the interned String, set the first time it is evaluated
 };
 
 class FunctionLiteral : public Expression {
  public:
-  ~FunctionLiteral() {
-    for(auto param : parameters) {
-      delete param;
-    }
-  }
+  ~FunctionLiteral();
 
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "FunctionLiteral"; }
+  NodeKind Kind() { return FUNCTION_LITERAL_NODE; }
   
   Token token;
   std::vector<Identifier*> parameters;
   BlockStatement* body;
+  Scope* scope = nullptr;  // set by the Resolver
+  Arena* arena = nullptr;  // holds this node, retained by the Function objects
+  Object* compiled = nullptr;  // the CompiledFunction of the vm, freed with the node
 };
 
 class ArrayLiteral : public Expression {
  public:
-  ~ArrayLiteral() {
-    for(auto elem : elements) {
-      delete elem;
-    }
-  }
-
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "ArrayLiteral"; }
+  NodeKind Kind() { return ARRAY_LITERAL_NODE; }
   
   Token token;
   std::vector<Expression*> elements;
 };
 
-class CallExpression : public Expression {
+class HashLiteral : public Expression {
  public:
-  ~CallExpression() {
-   for(auto arg : arguments) {
-      delete arg;
-    }
-    delete function;
-  }
+  std::string TokenLiteral() { return token.literal; }
+  std::string String();
+  std::string Type() { return "HashLiteral"; }
+  NodeKind Kind() { return HASH_LITERAL_NODE; }
+
+  Token token;  // "{"
+  std::vector<std::pair<Expression*, Expression*>> pairs;
+};
 
+class CallExpression : public Expression {
+ public:
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "CallExpression"; }
+  NodeKind Kind() { return CALL_EXPRESSION_NODE; }
   
   Token token;
   Expression* function;
@@ -151,6 +201,7 @@ class IndexExpression : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "IndexExpression"; }
+  NodeKind Kind() { return INDEX_EXPRESSION_NODE; }
 
   Token token;
   Expression* array;
@@ -162,6 +213,7 @@ class PrefixExpression : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "PrefixExpression"; }
+  NodeKind Kind() { return PREFIX_EXPRESSION_NODE; }
   
   Token token;
   std::string op;
@@ -173,6 +225,7 @@ class InfixExpression : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "InfixExpression"; }
+  NodeKind Kind() { return INFIX_EXPRESSION_NODE; }
   
   Token token;
   Expression* left;
@@ -185,6 +238,7 @@ class IfExpression : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "IfExpression"; }
+  NodeKind Kind() { return IF_EXPRESSION_NODE; }
   
   Token token;  // if
   Expression* condition;
@@ -197,6 +251,7 @@ class WhileExpression : public Expression {
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "WhileExpression"; }
+  NodeKind Kind() { return WHILE_EXPRESSION_NODE; }
   
   Token token;  // if
   Expression* condition;
@@ -209,45 +264,40 @@ class WhileExpression : public Expression {
 // for code like: let x = 5;
 class LetStatement : public Statement {
  public:
-  ~LetStatement() {
-    delete value;
-  }
   void statementNode() { }
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "LetStatement"; }
+  NodeKind Kind() { return LET_STATEMENT_NODE; }
 
   Token token;  // token LET
   Identifier name;
   Expression* value;
 };
 
-// for statement like &a = 6;
+// for statement like &a = 6; or &a[i][j] = 6;
 class RefStatement : public Statement {
  public:
-  ~RefStatement() {
-    delete value;
-  }
   void statementNode() { }
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "RefStatement"; }
+  NodeKind Kind() { return REF_STATEMENT_NODE; }
 
   Token token;  // token &
   Identifier name;
+  std::vector<Expression*> indexes;  // empty when the variable itself is assigned
   Expression* value;
 };
 
 // for code like: return 10;
 class ReturnStatement : public Statement {
  public:
-  ~ReturnStatement() {
-    delete returnValue;
-  }
   void statementNode() { }
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "ReturnStatement"; }
+  NodeKind Kind() { return RETURN_STATEMENT_NODE; }
 
   Token token;  // token RETURN
   Expression* returnValue;
@@ -256,13 +306,11 @@ class ReturnStatement : public Statement {
 // for code like: x + 10;
 class ExpressionStatement : public Statement {
  public:
-  ~ExpressionStatement() {
-    delete expression;
-  }
   void statementNode() {}
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "ExpressionStatement"; }
+  NodeKind Kind() { return EXPRESSION_STATEMENT_NODE; }
 
   Token token;  // the first token of the expression
   Expression* expression;
@@ -270,15 +318,11 @@ class ExpressionStatement : public Statement {
 
 class BlockStatement : public Statement {
  public:
-  ~BlockStatement() {
-    for(auto stmt : statements) {
-      delete stmt;
-    }
-  }
   void statementNode() {}
   std::string TokenLiteral() { return token.literal; }
   std::string String();
   std::string Type() { return "BlockStatement"; }
+  NodeKind Kind() { return BLOCK_STATEMENT_NODE; }
 
   Token token; // "{"
   std::vector<Statement*> statements;
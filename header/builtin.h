@@ -0,0 +1,28 @@
+#ifndef MONKEY_BUILTIN_H_
+#define MONKEY_BUILTIN_H_
+
+#include <unordered_map>
+#include <string>
+#include "object.h"
+
+namespace monkey {
+
+// shared by the evaluator and the vm
+extern std::unordered_map<std::string, Builtin*> builtin;
+
+bool isTruthy(Value condition);
+bool isError(Value o);
+
+// string literals are interned for the whole program and pinned,
+// identical constants share one String. the table is never freed, so with
+// --stream the literals are not interned, see Evaluator and Compiler.
+String* intern(const std::string& value);
+// the interned strings of a single character, what indexing a string gives
+String* charString(char ch);
+// a pinned String is copied before it is bound to a name or put in an array,
+// because a reference assignment changes the string in place.
+bool isPinned(Value o);
+
+}  // namespace monkey
+
+#endif  // MONKEY_BUILTIN_H_
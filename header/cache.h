@@ -0,0 +1,73 @@
+#ifndef MONKEY_CACHE_H_
+#define MONKEY_CACHE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "ast.h"
+
+namespace monkey {
+
+// fnv-1a of the source, the key of its cached Program
+uint64_t SourceHash(const char* source, size_t size);
+
+// binary form of a parsed Program, so that a script that did not change
+// skips the lexer and the parser. the nodes are written in preorder, and
+// a token is written as its type and its place in the source, so the
+// nodes read back borrow the source just like the ones of the Parser.
+// offsets, lengths and counts are varints, most of them take one byte.
+// the layout is that of this machine, the cache is not meant to be shared.
+class AstWriter {
+ public:
+  std::string Write(Program* program, const char* source, size_t size, uint64_t hash);
+ private:
+  template <typename T>
+  void put(T val) { out.append((const char*)&val, sizeof(T)); }
+  void putVarint(uint64_t val);
+  void putToken(const Token& tok);
+  void putCount(size_t count) { putVarint(count); }
+  void putNode(Node* node);
+
+  std::string out;
+  const char* source;
+  size_t lastOffset;  // tokens are stored relative to the previous one
+};
+
+// reads straight from the bytes of a mapped cache file
+class AstReader {
+ public:
+  // nullptr if data does not hold a Program written for this source
+  Program* Read(const char* data, size_t dataSize, const char* source, size_t size, uint64_t hash);
+ private:
+  template <typename T>
+  T get() {
+    T val = T();
+    if (pos + sizeof(T) > end) {
+      ok = false;
+      return val;
+    }
+    memcpy(&val, pos, sizeof(T));
+    pos += sizeof(T);
+    return val;
+  }
+  uint64_t getVarint();
+  Token getToken();
+  size_t getCount();
+  Node* getNode();
+  Expression* getExpression();
+  Statement* getStatement();
+  BlockStatement* getBlock(bool optional = false);
+  void getIdentifier(Identifier* ident);
+
+  const char* pos;
+  const char* end;
+  const char* source;
+  size_t size;
+  size_t lastOffset;
+  Arena* arena;
+  bool ok;
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_CACHE_H_
@@ -0,0 +1,75 @@
+#ifndef MONKEY_CODE_H_
+#define MONKEY_CODE_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace monkey {
+
+typedef std::vector<uint8_t> Instructions;
+typedef uint8_t Opcode;
+
+// operands are stored little endian right after the opcode.
+enum : Opcode {
+  OP_CONSTANT,        // push constants[u32]
+  OP_STRING,          // push a new String of strings[u32]
+  OP_POP,
+  OP_TRUE,
+  OP_FALSE,
+  OP_NULL,
+  // infix operators, pop right and left, push the result
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_EQ,
+  OP_NE,
+  OP_GT,
+  OP_LT,
+  OP_GE,
+  OP_LE,
+  // prefix operators
+  OP_MINUS,
+  OP_BANG,
+  OP_JUMP,            // jump to u32
+  OP_JUMP_NOT_TRUTHY, // pop the condition, jump to u32 if not truthy
+  // variables, see VariableKind. get, set and ref in the same order
+  // for every kind of variable, the compiler relies on it.
+  OP_GET_LOCAL,       // push slot u32 of the current environment
+  OP_SET_LOCAL,       // let slot u32 = pop
+  OP_REF_LOCAL,       // &slot u32 = pop
+  OP_GET_GLOBAL,      // the same for slot u32 of the top level environment
+  OP_SET_GLOBAL,
+  OP_REF_GLOBAL,
+  OP_GET_CELL,        // the same for the Cell in slot u32 of the current environment
+  OP_SET_CELL,
+  OP_REF_CELL,
+  OP_GET_UPVALUE,     // push the value of upvalue u32 of the running closure
+  OP_ARRAY,           // pop u32 elements, push an array of them
+  OP_HASH,            // pop u32 pairs of key and value, push a hash of them
+  OP_INDEX,           // pop index and array, push array[index]
+  OP_SET_INDEX,       // pop value, index and array, array[index] = value in place
+  OP_CLOSURE,         // push a new closure of constants[u32], capturing its upvalues
+  OP_CALL,            // call the function below u32 arguments
+  OP_TAIL_CALL,       // OP_CALL of return f(...), reuses the frame when f is running
+  OP_RETURN_VALUE,    // return the top of stack from the current frame
+};
+
+class Definition {
+ public:
+  std::string name;
+  std::vector<int> operandWidths;
+};
+
+Definition& Lookup(Opcode op);
+
+Instructions Make(Opcode op, std::vector<int> operands = std::vector<int>());
+int ReadOperand(const uint8_t* ins, int width);
+// disassemble, for debugging the compiler
+std::string InstructionsString(const Instructions& ins);
+
+}  // namespace monkey
+
+#endif  // MONKEY_CODE_H_
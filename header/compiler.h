@@ -0,0 +1,45 @@
+#ifndef MONKEY_COMPILER_H_
+#define MONKEY_COMPILER_H_
+
+#include <vector>
+#include <string>
+#include "code.h"
+#include "ast.h"
+#include "object.h"
+
+namespace monkey {
+
+// lower a resolved ast into bytecode for the vm.
+// variables live in the same Environment slots as in the Evaluator,
+// so the semantic of scoping stays the same.
+class Compiler {
+ public:
+  // without interning a string literal is compiled to OP_STRING, see Evaluator
+  Compiler(bool internLiterals = true) : scopes(1), internLiterals(internLiterals) { }
+  void Compile(Program* program);
+  std::vector<std::string> Errors() { return errors; }
+  Bytecode& GetBytecode() { return bytecode; }
+ private:
+  // every statement and expression may be compiled "for value", leaving
+  // exactly one object on the stack, or "for effect", leaving nothing.
+  void compileStatements(std::vector<Statement*>& statements, bool keep);
+  void compileStatement(Statement* stmt, bool keep);
+  void compileExpression(Expression* exp, bool keep);
+  void compileCall(CallExpression* call, Opcode op);
+  void compileFunction(FunctionLiteral* fn);
+
+  int emit(Opcode op, std::vector<int> operands = std::vector<int>());
+  int addConstant(Value obj);
+  void emitVariable(Identifier* ident, Opcode local);
+  void changeOperand(int pos, int operand);
+  Instructions& currentInstructions() { return scopes.back().instructions; }
+
+  Bytecode bytecode;
+  std::vector<Bytecode> scopes;  // one for each function being compiled
+  std::vector<std::string> errors;
+  bool internLiterals;
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_COMPILER_H_
@@ -1,75 +1,151 @@
 #ifndef MONKEY_ENVIRONMENT_H_
 #define MONKEY_ENVIRONMENT_H_
 
-#include <unordered_map>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include "object.h"
+#include "resolver.h"
 
 namespace monkey {
-// environment should only detach object pointer from store
-// never delete in environment
+
+// calls nested deeper than this return an Error, set by --max-depth
+// or MONKEY_MAX_DEPTH. tail calls do not nest.
+const int DEFAULT_MAX_DEPTH = 100000;
+
+// most functions have a few parameters and locals
+const size_t INLINE_SLOTS = 4;
+// environments kept for reuse, the rest of a deep recursion is freed
+const size_t MAX_FREE_ENVIRONMENTS = 1024;
+
+// the slots of an Environment. up to INLINE_SLOTS are stored in the
+// Environment itself, more move to a buffer on the heap, which is kept
+// when the Environment is reused.
+class Slots {
+ public:
+  Slots() : data(inlined), count(0), capacity(INLINE_SLOTS) { }
+  Slots(const Slots&) = delete;
+  Slots& operator=(const Slots&) = delete;
+
+  size_t size() const { return count; }
+  Value& operator[](size_t i) { return data[i]; }
+  Value* begin() { return data; }
+  Value* end() { return data + count; }
+
+  void assign(size_t n, Value val) {
+    reserve(n);
+    std::fill(data, data + n, val);
+    count = n;
+  }
+  void resize(size_t n, Value val) {
+    reserve(n);
+    for (size_t i = count; i < n; i++)
+      data[i] = val;
+    count = n;
+  }
+
+ private:
+  void reserve(size_t n) {
+    if (n <= capacity)
+      return;
+    std::vector<Value> grown(std::max(n, capacity * 2));
+    std::copy(data, data + count, grown.begin());
+    heap.swap(grown);
+    data = heap.data();
+    capacity = heap.size();
+  }
+
+  Value* data;
+  size_t count;
+  size_t capacity;
+  Value inlined[INLINE_SLOTS];
+  std::vector<Value> heap;
+};
+
+// never delete objects in environment, they belong to the garbage collector.
+// variables live in slots laid out by a Scope of the Resolver.
 class Environment {
 public:
-  Environment() : outer(nullptr) { }
-  ~Environment() {
-    store.clear();
+  Environment(Scope* scope) : scope(scope), outer(nullptr) {
+    slots.assign(scope->names.size(), Value::Unbound());
   }
-  Environment* NewEnclosedEnvironment() {
-    Environment* inner = new Environment();
-    inner->outer = this;
-    return inner;
+  // environments of calls come from a free list, Release gives them back
+  Environment* NewEnclosedEnvironment(Scope* scope);
+  void Release();
+
+  // the top level variable of that name, for a variable read before it is
+  // bound. Unbound if there is none, builtins are looked up this way too.
+  Value Get(const std::string& name) {
+    int slot = scope->Find(name);
+    return slot != -1 ? GetSlot(slot) : Value::Unbound();
   }
 
-  Object* Get(std::string name) {
-    if(store.find(name) == store.end()) {
-      if (outer != nullptr) {
-        Object* obj = outer->Get(name);
-        return obj;
-      }
-      return new Error("identifier not found: " + name);
-    }
-    return store[name];
+  // Unbound if nothing was bound to the slot yet
+  Value GetSlot(int slot) {
+    return slot < (int)slots.size() ? slots[slot] : Value::Unbound();
   }
 
   // we can only use let to set.
   // no assignments for outer variables.
-  Object* Set(std::string name, Object* val) {
-    if (val->Type() == RETURN_VALUE_OBJ) 
-      store[name] = ((ReturnValue*)val)->value;
+  Value SetSlot(int slot, Value val) {
+    if (slot >= (int)slots.size())  // the top level scope grows with every line of the repl
+      slots.resize(scope->names.size(), Value::Unbound());
+    if (val.Is(RETURN_VALUE_OBJ)) 
+      slots[slot] = ((ReturnValue*)val.AsObject())->value;
     else
-      store[name] = val;
+      slots[slot] = val;
     return __NULL;
   }
 
-  Object* RefSet(std::string name, Object* val) {
-    if(store.find(name) == store.end())
+  Value RefSetSlot(int slot, Value val) {
+    if (slot >= (int)slots.size())
+      return new Error(Error("identifier not defined: " + scope->names[slot]));
+    return RefSet(slots[slot], val, scope->names[slot]);
+  }
+
+  // &name = val, where target holds the variable: a slot or a Cell
+  static Value RefSet(Value& target, Value val, const std::string& name) {
+    if(target.IsUnbound())
       return new Error(Error("identifier not defined: " + name));
-    Object* old = Get(name);
-    if(old->Type() != val->Type())
+    Value old = target;
+    if(old.Type() != val.Type())
       return new Error("does not support different type reference assign yet");
+    // integers, booleans and null are stored inline, so they can only be rebound.
+    // arrays and hashes are rebound too instead of copied, &a[i] = v is
+    // what changes them in place.
+    if(!val.IsObject() || val.Is(ARRAY_OBJ) || val.Is(HASH_OBJ)) {
+      target = val;
+      return __NULL;
+    }
     // we cannot have virtual constructor function in C++
     // therefore, we could not use virtual copy constructor
     // TODO: find a better way
+    // only copy the payload, next and mark belong to the garbage collector.
+    Object* oldObj = old.AsObject();
+    Object* valObj = val.AsObject();
 
-    if (val->Type() == INTEGER_OBJ)
-      *(Integer*)old = Integer(((Integer*)val)->value);
-    else if (val->Type() == STRING_OBJ)
-      *(String*)old = String(((String*)val)->value);
-    else if (val->Type() == RETURN_VALUE_OBJ)
-      *(ReturnValue*)old = RefSet(name, ((ReturnValue*)val)->value);
-    else if (val->Type() == FUNCTION_OBJ)
-      *(Function*)old = Function(((Function*)val)->parameters, ((Function*)val)->body);
-    else if (val->Type() == ARRAY_OBJ)
-      *(Array*)old = Array(((Array*)val)->elements);
-    else  // boolean and null
-      Set(name, val);
+    if (val.Is(STRING_OBJ))
+      ((String*)oldObj)->value = ((String*)valObj)->value;
+    else if (val.Is(RETURN_VALUE_OBJ))
+      return RefSet(target, ((ReturnValue*)valObj)->value, name);
+    else if (val.Is(FUNCTION_OBJ))
+      ((Function*)oldObj)->Assign((Function*)valObj);
+    else
+      target = val;
     return __NULL;
   }
 
-  std::unordered_map<std::string, Object*> store;
+  Scope* scope;
+  Slots slots;
+  // the environment of the caller. scoping is lexical, only the garbage
+  // collector follows it, to mark the variables of all running calls.
   Environment* outer;
+
+ private:
+  static Environment* freeList;  // linked through outer
+  static size_t freeCount;
 };
 
 }  // namespace monkey
 
-#endif  // MONKEY_ENVIRONMENT_H_
\ No newline at end of file
+#endif  // MONKEY_ENVIRONMENT_H_
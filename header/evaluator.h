@@ -12,25 +12,63 @@
 namespace monkey {
 class Evaluator {
  public:
-  Object* Eval(Node* node, Environment* env);
+  // without interning every string literal evaluates to a new String,
+  // for --stream where the literals of the freed statements must go too.
+  Evaluator(GCOptions options = GCOptions(), int maxDepth = DEFAULT_MAX_DEPTH,
+            bool internLiterals = true);
+  Value Eval(Node* node, Environment* env);
+  // the last Program evaluated stopped at a top level return
+  bool Returned() { return returned; }
+  long Allocations() { return gc.allocated; }
+  GCStats& Stats() { return gc.stats; }
  private:
-  Object* evalStatements(std::vector<Statement*> statements, Environment* env);
-  Object* evalBangOperatorExpression(Object* right);
-  Object* evalMinusPrefixExpression(Object* right);
-  Object* evalPrefixExpression(std::string op, Object* right);
-  Object* evalIntegerInfixExpression(std::string op, Object* left, Object* right);
-  Object* evalStringInfixExpression(std::string op, Object* left, Object* right);
-  Object* evalInfixExpression(std::string op, Object* left, Object* right);
-  Environment* extendedFunctionEnv(Function* fn, std::vector<Object*>& args, Environment* env);
-  Object* evalIndexExpression(Object* array, Object* index, Environment* env);
-  Object* evalArrayIndexExpression(Array* array, Integer* index);
-  Object* evalStringIndexExpression(String* array, Integer* index);
-  Object* evalCallExpression(Object* fn, std::vector<Object*>& args, Environment* env);
-  Object* evalIdentifier(std::string name, Environment* env);
-  Object* evalProgram(Program* program, Environment* env);
+  Value evalStatements(std::vector<Statement*>& statements, Environment* env);
+  Value evalBangOperatorExpression(Value right);
+  Value evalMinusPrefixExpression(Value right);
+  Value evalPrefixExpression(std::string op, Value right);
+  Value evalIntegerInfixExpression(std::string op, Value left, Value right);
+  Value evalStringInfixExpression(std::string op, Value left, Value right);
+  Value evalInfixExpression(std::string op, Value left, Value right);
+  Environment* extendedFunctionEnv(Function* fn, std::vector<Value>& args, Environment* env);
+  void bindArguments(Function* fn, const Value* args, Environment* env);
+  Value setVariable(Identifier* name, Value val, Environment* env);
+  Value refSetVariable(Identifier* name, Value val, Environment* env);
+  void keepRunning(Value fn);
+  Function* newClosure(FunctionLiteral* literal, Environment* env);
+  Value evalIndexExpression(Value array, Value index, Environment* env);
+  Value evalArrayIndexExpression(Array* array, Value index);
+  Value evalStringIndexExpression(String* array, Value index);
+  Value evalHashIndexExpression(Hash* hash, Value key);
+  Value hashKey(Value key);
+  Value evalIndexAssignment(RefStatement* ref, Environment* env);
+  Value setIndex(Value container, Value index, Value val);
+  Value evalHashLiteral(HashLiteral* literal, Environment* env);
+  Value evalCall(CallExpression* call, Environment* env, bool tail);
+  Value evalCallExpression(Value callee, std::vector<Value>& args, Environment* env);
+  Value evalIdentifier(Identifier* ident, Environment* env);
+  Value evalProgram(Program* program, Environment* env);
+  Value unpin(Value val);
 
   GarbageCollector gc;
-  int gcCounter = 0;
+  // shadow stack of the temporaries that are still needed
+  // while the rest of an expression is evaluated, scanned by each collection
+  std::vector<Value> roots;
+  bool returned = false;
+  Environment* globals = nullptr;  // the environment of evalProgram
+  // the Function of every running call, the last one holds the upvalues
+  std::vector<Value> closures;
+  // return f(...) inside f itself is a tail call: the body returns
+  // tailCall with f and the arguments in tailArgs, and the running call
+  // binds them in its own environment and evaluates the body again.
+  ReturnValue tailCall;
+  std::vector<Value> tailArgs;
+  // every call nests Eval on the native stack, deep recursion returns an
+  // Error before it runs out. the VM keeps its frames on the heap instead.
+  int depth = 0;
+  int maxDepth;
+  char* stackBase = nullptr;  // where evalProgram started
+  size_t stackLimit;  // native stack the calls may use
+  bool internLiterals;
 
 };
   
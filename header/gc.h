@@ -1,5 +1,10 @@
 #ifndef MONKEY_GC_H_
 #define MONKEY_GC_H_
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
 #include "object.h"
 #include "environment.h"
 
@@ -7,58 +12,318 @@ namespace monkey {
 
 class Environment;
 
+const size_t DEFAULT_GC_THRESHOLD = 1 << 20;
+const double DEFAULT_GC_GROWTH = 2.0;
+const long DEFAULT_GC_BUDGET = 1000;
+
+// set by main.cpp from --gc-threshold, --gc-growth, --gc-budget
+// or MONKEY_GC_THRESHOLD, MONKEY_GC_GROWTH, MONKEY_GC_BUDGET
+struct GCOptions {
+  size_t threshold = DEFAULT_GC_THRESHOLD;  // bytes allocated before a minor collection
+  double growth = DEFAULT_GC_GROWTH;  // the old generation may grow by this factor before a major collection
+  long budget = DEFAULT_GC_BUDGET;  // objects marked per slice, 0 marks everything at once
+};
+
+// pauses up to 10us, 100us, 1ms, 10ms, 100ms and longer
+const int PAUSE_BUCKETS = 6;
+
+struct GCStats {
+  long minor = 0;
+  long major = 0;
+  long pauses = 0;  // slices of all the collections
+  double totalPauseMs = 0;
+  double maxPauseMs = 0;
+  long histogram[PAUSE_BUCKETS] = {0};
+  size_t bytesFreed = 0;
+  size_t peakHeap = 0;  // bytes
+
+  std::string String() {
+    const char* limits[PAUSE_BUCKETS] = {"<=10us", "<=100us", "<=1ms", "<=10ms", "<=100ms", ">100ms"};
+    std::string histo;
+    for (int i = 0; i < PAUSE_BUCKETS; i++)
+      histo += std::string(" ") + limits[i] + ":" + std::to_string(histogram[i]);
+    return "gc: " + std::to_string(minor + major) + " collections (" +
+        std::to_string(minor) + " minor, " + std::to_string(major) + " major)\n" +
+        "gc: " + std::to_string(pauses) + " pauses, total " + std::to_string(totalPauseMs) +
+        " ms, longest " + std::to_string(maxPauseMs) + " ms\n" +
+        "gc: pauses" + histo + "\n" +
+        "gc: " + std::to_string(bytesFreed) + " bytes freed, peak heap " +
+        std::to_string(peakHeap) + " bytes\n";
+  }
+};
+
+// generational, incremental mark and sweep.
+// new objects go to the young list, a minor collection only sweeps that list
+// and promotes the survivors to the old list. old objects count as alive
+// and are not traced. a young object stored into an old one after its
+// promotion is kept in the remembered set and traced by the next collection,
+// the old object itself is not scanned again.
+// a collection is due once the young objects take options.threshold bytes.
+// once the old list grew by options.growth since the last major collection
+// the next collection is a major one and sweeps both lists.
+// objects cannot move, values point to them from the c++ stack as well.
+//
+// marking is tri-color: white objects are not marked, gray ones are marked
+// and wait in the gray list, black ones are marked and their elements too.
+// it runs in slices at the safe points of the evaluator and the vm, see Step,
+// each slice traces at most options.budget objects and elements, long arrays
+// and hashes are traced over several slices. marking keeps everything that
+// was reachable when it started: the roots are marked once at the start,
+// a value an object drops meanwhile is marked by Forget, and objects
+// allocated meanwhile are black. so it ends once the gray list is empty,
+// however fast the program allocates. sweeping runs in slices as well.
 class GarbageCollector {
  public:
-  GarbageCollector() { head = new String("head"); }
-  ~GarbageCollector() { delete head; }
+  GarbageCollector(GCOptions options = GCOptions()) : options(options),
+      young(nullptr), old(nullptr), sweepYoung(nullptr), sweepOld(nullptr),
+      youngBytes(0), oldBytes(0), sweepBytes(0), majorThreshold(options.threshold * options.growth),
+      major(false), marking(false), sweeping(false) { }
   void Add(Object* obj) {
-    obj->next = head->next;
-    head->next = obj;
+    allocated++;
+    youngBytes += obj->Size();
+    stats.peakHeap = std::max(stats.peakHeap, youngBytes + oldBytes + sweepBytes);
+    obj->next = young;
+    young = obj;
+    if (marking) {
+      obj->mark = true;
+      obj->old = true;
+    }
+  }
+
+  // called at a safe point, markRoots marks everything the caller holds.
+  // starts a collection once enough was allocated and marks the roots,
+  // later calls mark a slice of the gray list each, then sweep a slice
+  // of the lists each.
+  template <typename MarkRoots>
+  void Step(MarkRoots markRoots) {
+    if (!marking && !sweeping && youngBytes < options.threshold)
+      return;
+    auto start = std::chrono::steady_clock::now();
+    if (sweeping) {
+      sweep(options.budget);
+    } else if (!marking) {
+      marking = true;
+      markRoots();
+    } else if (drain(options.budget)) {
+      startSweep();
+    }
+    recordPause(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+
+  // write barrier, call after val was stored into container in place.
+  // while marking there is nothing to do, everything alive at the end is old.
+  void Remember(Value container, Value val) {
+    if (marking || !container.IsObject() || !val.IsObject())
+      return;
+    Object* from = container.AsObject();
+    Object* to = val.AsObject();
+    if (from->old && !to->old && !to->pinned && !to->remembered) {
+      to->remembered = true;
+      remembered.push_back(to);
+    }
+  }
+
+  // write barrier, call before an object drops val, when it is overwritten
+  // or removed. the program may still hold it, so it survives the marking
+  // that has started. a function changed in place by &f = g drops its
+  // upvalues.
+  void Forget(Value val) {
+    if (!marking)
+      return;
+    Mark(val);
+    if (val.Is(FUNCTION_OBJ))
+      Mark(((Function*)val.AsObject())->upvalues);
+  }
+
+  // after a function was changed in place, it has the upvalues of another
+  void Remember(Value fn) {
+    if (!fn.Is(FUNCTION_OBJ))
+      return;
+    for (auto up : ((Function*)fn.AsObject())->upvalues)
+      Remember(fn, up);
   }
 
+  // only heap objects need marking
+  void Mark(Value val) {
+    if(val.IsObject())
+      Mark(val.AsObject());
+  }
+
+  void Mark(const std::vector<Value>& values) {
+    for (auto val : values)
+      Mark(val);
+  }
+
+  // gray an object, its elements are traced by a later slice.
+  // it survives the collection, so it counts as old from now on.
   void Mark(Object* obj) {
-    if(obj->mark)
+    if(obj->mark || obj->pinned || (obj->old && !major))
       return;
     obj->mark = true;
+    obj->old = true;
+    gray.push_back(Gray{obj, SIZE_MAX});
+  }
+
+  void Mark(Environment* env) {
+    for (; env != nullptr; env = env->outer) {
+      for(auto val : env->slots) {
+        Mark(val);
+      }
+    }
+  }
+
+  long allocated = 0;  // objects added since the collector was created
+  GCStats stats;
+
+ private:
+  // the elements of an array or the pairs of a hash below end are not
+  // traced yet. they are traced from the last one down: elements do not
+  // move, and pairs only move down when a hash drops its deleted pairs,
+  // so none is missed. what is overwritten goes through Forget.
+  struct Gray {
+    Object* obj;
+    size_t end;
+  };
+
+  // traces the elements of an object, at most work of them. the rest
+  // goes back to the gray list below the elements just grayed, so they
+  // are traced first and the gray list stays short.
+  void markChildren(Gray item, long& work) {
+    Object* obj = item.obj;
     if (obj->Type() == ARRAY_OBJ) {
-      for (auto elem : ((Array*)obj)->elements) {
-        Mark(elem);
+      Array* array = (Array*)obj;
+      size_t end = std::min(item.end, array->Length());
+      size_t from = deferRest(obj, end, work);
+      while (end > from)
+        Mark(array->Get(--end));
+    } else if (obj->Type() == HASH_OBJ) {
+      auto& pairs = ((Hash*)obj)->pairs;
+      size_t end = std::min(item.end, pairs.size());
+      size_t from = deferRest(obj, end, work);
+      for (; end > from; end--) {
+        Mark(pairs[end - 1].key);
+        Mark(pairs[end - 1].value);
       }
+    } else if (obj->Type() == RETURN_VALUE_OBJ) {
+      Mark(((ReturnValue*)obj)->value);
+    } else if (obj->Type() == FUNCTION_OBJ) {
+      Mark(((Function*)obj)->upvalues);
+    } else if (obj->Type() == CELL_OBJ) {
+      Mark(((Cell*)obj)->value);
     }
   }
 
-  void Mark(Environment* env) {
-    for(std::pair<std::string, Object*> p : env->store) {
-      Integer tmp = *(Integer*)(p.second);
-      Object* obj = p.second;
-      Mark(obj);
+  // the elements below end that are left for a later slice, after work
+  // of them are traced now, and puts them back to the gray list
+  size_t deferRest(Object* obj, size_t end, long& work) {
+    size_t count = work < 0 ? end : std::min(end, (size_t)work);
+    if (work >= 0)
+      work -= count;
+    if (end > count)
+      gray.push_back(Gray{obj, end - count});
+    return end - count;
+  }
+
+  // traces up to budget objects and elements, all with 0. the remembered
+  // young objects are grayed on the way. returns if nothing is left.
+  bool drain(long budget) {
+    long work = budget == 0 ? -1 : budget;
+    while (work != 0) {
+      if (!gray.empty()) {
+        Gray item = gray.back();
+        gray.pop_back();
+        markChildren(item, work);
+        if (work != 0)
+          work--;
+      } else if (!remembered.empty()) {
+        Object* obj = remembered.back();
+        remembered.pop_back();
+        obj->remembered = false;
+        Mark(obj);
+        work--;
+      } else {
+        break;
+      }
     }
-    if(env->outer != nullptr) {
-      Mark(env->outer);
+    return gray.empty() && remembered.empty();
+  }
+
+  // the lists are swept by the next slices, new objects go to fresh ones
+  void startSweep() {
+    marking = false;
+    sweeping = true;
+    sweepYoung = young;
+    young = nullptr;
+    sweepBytes = youngBytes;
+    youngBytes = 0;
+    if (major) {
+      sweepOld = old;
+      old = nullptr;
+      sweepBytes += oldBytes;
+      oldBytes = 0;
     }
   }
 
-  void Sweep() {
-    Object* node = head;
-    while(node->next != nullptr) {
-      if (!node->next->mark) {
-        Object* tmp = node->next;
-        node->next = tmp->next;
-        delete tmp;
-      } else {
-        node = node->next;
+  // frees up to budget unmarked objects or keeps the marked ones, all
+  // with 0. the young survivors move to the old list.
+  void sweep(long budget) {
+    for (long n = 0; budget == 0 || n < budget; n++) {
+      Object*& list = sweepOld != nullptr ? sweepOld : sweepYoung;
+      if (list == nullptr)
+        break;
+      Object* obj = list;
+      list = list->next;
+      sweepBytes -= std::min(sweepBytes, obj->Size());  // arrays change size while they share a buffer
+      if (!obj->mark) {
+        stats.bytesFreed += obj->Size();
+        delete obj;
+        continue;
       }
+      obj->mark = false;
+      oldBytes += obj->Size();
+      obj->next = old;
+      old = obj;
     }
-    node = head;
-    while(node->next != nullptr) {
-      node->next->mark = false;
-      node = node->next;
+    if (sweepOld != nullptr || sweepYoung != nullptr)
+      return;
+    sweeping = false;
+    sweepBytes = 0;
+    if (major) {
+      stats.major++;
+      majorThreshold = std::max((size_t)(oldBytes * options.growth), options.threshold);
+    } else {
+      stats.minor++;
     }
+    major = oldBytes >= majorThreshold;
+  }
+
+  void recordPause(double ms) {
+    stats.pauses++;
+    stats.totalPauseMs += ms;
+    stats.maxPauseMs = std::max(stats.maxPauseMs, ms);
+    int bucket = 0;
+    for (double limit = 0.01; bucket < PAUSE_BUCKETS - 1 && ms > limit; limit *= 10)
+      bucket++;
+    stats.histogram[bucket]++;
   }
 
-  Object* head;
+  GCOptions options;
+  Object* young;
+  Object* old;
+  Object* sweepYoung;  // the lists of the collection being swept
+  Object* sweepOld;
+  size_t youngBytes;  // allocated since the last collection
+  size_t oldBytes;
+  size_t sweepBytes;  // in the lists not swept yet
+  size_t majorThreshold;
+  bool major;  // the current collection also sweeps the old list
+  bool marking;  // a collection has started and not finished marking
+  bool sweeping;  // marking is done and the lists are not swept yet
+  std::vector<Gray> gray;
+  std::vector<Object*> remembered;  // young objects stored into old ones
 };
 
 }  // namespace monkey
 
-#endif  // MONKEY_GC_
\ No newline at end of file
+#endif  // MONKEY_GC_
@@ -1,30 +1,36 @@
-#ifndef MONKEY_LEXER_H_
-#define MONKEY_LEXER_H_
-
-#include "token.h"
-#include <string>
-
-namespace monkey {
-
-class Lexer {
- public:
-  void New(std::string& input);
-  Token NextToken();
- private:
-  void readChar();
-  char peekChar();
-  std::string readIdentifier();
-  std::string readNumber();
-  std::string readString();
-  void skipWhitespace();
-
-  std::string input;
-  int position;
-  int readPosition;
-  char ch;
-};
-
-}  // namespace monkey
-
-
-#endif //MONKEY_LEXER_H_
+#ifndef MONKEY_LEXER_H_
+#define MONKEY_LEXER_H_
+
+#include "token.h"
+#include <string>
+
+namespace monkey {
+
+// the lexer borrows its input, which has to outlive the tokens
+// and the Program parsed from them.
+class Lexer {
+ public:
+  void New(const std::string& input) { New(input.data(), input.size()); }
+  void New(const char* input, size_t size);
+  Token NextToken();
+ private:
+  void readChar();
+  char peekChar();
+  Token readIdentifier();
+  Token readNumber();
+  Token readString();
+  Token single(TokenType type);
+  Token twoChars(TokenType type);
+  void skipWhitespace();
+
+  const char* input;
+  size_t size;
+  size_t position;
+  size_t readPosition;
+  char ch;
+};
+
+}  // namespace monkey
+
+
+#endif //MONKEY_LEXER_H_
@@ -3,7 +3,10 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "ast.h"
+#include "code.h"
+#include "pool.h"
 
 namespace monkey {
 
@@ -17,60 +20,112 @@ const ObjectType RETURN_VALUE_OBJ = "RETURN_VALUE";
 const ObjectType ERROR_OBJ    = "ERROR";
 const ObjectType FUNCTION_OBJ   = "FUNCTION";
 const ObjectType ARRAY_OBJ    = "ARRAY";
+const ObjectType HASH_OBJ     = "HASH";
 const ObjectType BUILTIN_OBJ    = "BUILTIN";
+const ObjectType COMPILED_FUNCTION_OBJ = "COMPILED_FUNCTION";
+const ObjectType CELL_OBJ       = "CELL";
 
 class Object {
  public:
-  Object() : next(nullptr), mark(0) {}
+  Object() : next(nullptr), mark(0), pinned(false), old(false), remembered(false) {}
   virtual ~Object() { }
   virtual ObjectType Type() = 0;
   virtual std::string Inspect() = 0;
+  virtual size_t Size() = 0;  // bytes owned by the object, for the gc thresholds
+
+  // every object comes from the size class of its type in the Pool
+  static void* operator new(size_t size) { return Pool::Allocate(size); }
+  static void operator delete(void* p, size_t size) { Pool::Free(p, size); }
 
   // for GC (mark and sweep)
   Object* next;
   bool mark;
+  bool pinned;  // interned, never tracked or freed by a collector
+  bool old;  // survived a collection, or marked by the running one
+  bool remembered;  // young and in the remembered set of the collector
 };
 
-class Integer : public Object {
+// a value of the language, one tagged word.
+// integers, booleans and null are stored inline and never allocate,
+// anything else is a pointer to a heap Object (low bits are 0).
+class Value {
  public:
-  Integer(int v) : Object(), value(v) { }
-  ObjectType Type() { return INTEGER_OBJ; }
-  std::string Inspect() { return std::to_string(value); }
+  constexpr Value() : bits(NULL_TAG) { }
+  constexpr Value(Object* obj) : bits((uint64_t)(uintptr_t)obj) { }
 
-  int value;
-};
+  static constexpr Value FromInteger(int v) { return Value(((uint64_t)(uint32_t)v << 32) | INTEGER_TAG); }
+  static constexpr Value FromBoolean(bool b) { return Value(b ? TRUE_TAG : FALSE_TAG); }
+  // marks an environment slot that has not been bound yet, never a result.
+  static constexpr Value Unbound() { return Value((uint64_t)0); }
 
-class Boolean : public Object {
- public:
-  Boolean(bool b) : Object(), value(b) { }
-  ObjectType Type() { return BOOLEAN_OBJ; }
-  std::string Inspect() { return value ? "true" : "false"; }
+  bool IsObject() const { return (bits & TAG_MASK) == 0 && bits != 0; }
+  bool IsUnbound() const { return bits == 0; }
+  bool IsInteger() const { return (bits & TAG_MASK) == INTEGER_TAG; }
+  bool IsBoolean() const { return bits == TRUE_TAG || bits == FALSE_TAG; }
+  bool IsNull() const { return bits == NULL_TAG; }
+  // only check the type of heap objects
+  bool Is(const ObjectType& type) const { return IsObject() && AsObject()->Type() == type; }
+
+  Object* AsObject() const { return (Object*)(uintptr_t)bits; }
+  int AsInteger() const { return (int32_t)(bits >> 32); }
+  bool AsBoolean() const { return bits == TRUE_TAG; }
+
+  ObjectType Type() const {
+    if (IsInteger())
+      return INTEGER_OBJ;
+    if (IsBoolean())
+      return BOOLEAN_OBJ;
+    if (IsNull())
+      return NULL_OBJ;
+    return AsObject()->Type();
+  }
+  std::string Inspect() const {
+    if (IsInteger())
+      return std::to_string(AsInteger());
+    if (IsBoolean())
+      return AsBoolean() ? "true" : "false";
+    if (IsNull())
+      return "NULL";
+    return AsObject()->Inspect();
+  }
 
-  bool value;
+  bool operator==(const Value& other) const { return bits == other.bits; }
+  bool operator!=(const Value& other) const { return bits != other.bits; }
+
+ private:
+  static const uint64_t TAG_MASK = 7;
+  static const uint64_t INTEGER_TAG = 1;
+  static const uint64_t FALSE_TAG = 2;
+  static const uint64_t TRUE_TAG = 2 | 8;
+  static const uint64_t NULL_TAG = 4;
+
+  constexpr explicit Value(uint64_t bits) : bits(bits) { }
+
+  uint64_t bits;
 };
 
+const Value __NULL = Value();
+const Value __TRUE = Value::FromBoolean(true);
+const Value __FALSE = Value::FromBoolean(false);
+
 class String : public Object {
  public:
   String(std::string s) : Object(), value(s) { }
   ObjectType Type() { return STRING_OBJ; }
   std::string Inspect() { return value; }
+  size_t Size() { return sizeof(String) + value.capacity(); }
 
   std::string value;
 };
 
-class Null : public Object {
- public:
-  ObjectType Type() { return NULL_OBJ; }
-  std::string Inspect() { return "NULL"; }
-};
-
 class ReturnValue : public Object {
  public:
-  ReturnValue(Object* v) : Object(), value(v) { }
+  ReturnValue(Value v) : Object(), value(v) { }
   ObjectType Type() { return RETURN_VALUE_OBJ; }
-  std::string Inspect() { return value->Inspect(); }
+  std::string Inspect() { return value.Inspect(); }
+  size_t Size() { return sizeof(ReturnValue); }
     
-  Object* value;
+  Value value;
 };
 
 class Error : public Object {
@@ -78,71 +133,232 @@ class Error : public Object {
   Error(std::string msg) : Object(), message(msg) { }
   ObjectType Type() { return ERROR_OBJ; }
   std::string Inspect() { return "ERROR: " + message; }
+  size_t Size() { return sizeof(Error) + message.capacity(); }
   
   std::string message;
 };
 
 class Environment;
 
+// the code of the main program or of one function, with its own
+// constants, so it stays valid when the other statements have been freed.
+class Bytecode {
+ public:
+  Instructions instructions;
+  std::vector<Value> constants;
+  std::vector<std::string> strings;  // the literals that are not interned
+};
+
+// the bytecode of a FunctionLiteral, owned by the literal
+class CompiledFunction : public Object {
+ public:
+  CompiledFunction(Bytecode code, FunctionLiteral* literal) :
+      Object(), code(code), literal(literal) { }
+  ObjectType Type() { return COMPILED_FUNCTION_OBJ; }
+  std::string Inspect() { return "compiled " + literal->String(); }
+  size_t Size() { return sizeof(CompiledFunction) + code.instructions.capacity(); }
+
+  Bytecode code;
+  FunctionLiteral* literal;
+};
+
+// a variable captured by a closure. the Environment of the call that
+// defines it and the closures that use it share the cell, so they all
+// see the next let.
+class Cell : public Object {
+ public:
+  Cell() : Object(), value(Value::Unbound()) { }
+  ObjectType Type() { return CELL_OBJ; }
+  std::string Inspect() { return value.Inspect(); }
+  size_t Size() { return sizeof(Cell); }
+
+  Value value;
+};
+
+// parameters and body are owned by the FunctionLiteral in the ast,
+// a function object only refers to them and keeps their arena alive.
+// a closure also holds the Cells of the variables of enclosing functions
+// it uses, in the order of the captures of its Scope.
 class Function : public Object {
  public:
-  Function(std::vector<Identifier*>& params, BlockStatement* b) :
-      Object(), parameters(params), body(b) { }
-  ~Function() {
-    for(auto param : parameters)
-      delete param;
-    delete body;
+  Function(FunctionLiteral* literal, CompiledFunction* compiled = nullptr) :
+      Object(), literal(literal), compiled(compiled) {
+    literal->arena->Retain();
+  }
+  ~Function() { literal->arena->Release(); }
+
+  // the same function, for the calls still running it when &f = g
+  // changes it: they go on with their own code and upvalues
+  Function* Copy() {
+    Function* copy = new Function(literal, compiled);
+    copy->upvalues = upvalues;
+    return copy;
+  }
+
+  // &f = g, retain first, both may come from the same arena
+  void Assign(Function* other) {
+    other->literal->arena->Retain();
+    literal->arena->Release();
+    literal = other->literal;
+    compiled = other->compiled;
+    upvalues = other->upvalues;
   }
   
   ObjectType Type() { return FUNCTION_OBJ; }
   std::string Inspect() {
     std::string res =  "fn (";
-    for (auto ident : parameters) {
+    for (auto ident : literal->parameters) {
       res += ident->String() + ", ";
     }
-    res += ")" + body->String();
+    res += ")" + literal->body->String();
     return res;
   }
+  size_t Size() { return sizeof(Function) + upvalues.capacity() * sizeof(Value); }
 
-  std::vector<Identifier*> parameters;
-  BlockStatement* body;
+  FunctionLiteral* literal;  // parameters, body and the Scope of its environment
+  CompiledFunction* compiled;  // only set when created by the vm
+  std::vector<Value> upvalues;  // Cells
 };
 
+// the storage of arrays, shared by the arrays sliced or concatenated
+// from each other until one of them changes. counted like an Arena.
+class ArrayBuffer {
+ public:
+  ArrayBuffer() : refs(1) { }
+  ArrayBuffer(const ArrayBuffer&) = delete;
+  ArrayBuffer& operator=(const ArrayBuffer&) = delete;
+
+  void Retain() { refs++; }
+  void Release() {
+    if (--refs == 0)
+      delete this;
+  }
+
+  std::vector<Value> values;
+  long refs;
+};
+
+// the elements are values[start, start + length) of the buffer. slice,
+// rest and concat give arrays that share the buffer instead of copying
+// it, the first change through a shared buffer copies the elements into
+// one of its own (copy on write), so each array still looks like a value.
+// the values outside the range are not traced and never read.
+// elements are tracked by the garbage collector on their own.
 class Array : public Object {
  public:
-  Array(std::vector<Object*>& elems) :
-      Object(), elements(elems) { }
-  ~Array() {
-  for(auto elem : elements)
-    delete elem;
+  Array(std::vector<Value>& elems) :
+      Object(), buffer(new ArrayBuffer()), start(0), length(elems.size()) {
+    buffer->values = elems;
+  }
+  // elements [from, from + count) of source, in the same buffer
+  Array(Array* source, size_t from, size_t count) :
+      Object(), buffer(source->buffer), start(source->start + from), length(count) {
+    buffer->Retain();
   }
+  ~Array() { buffer->Release(); }
+
   ObjectType Type() { return ARRAY_OBJ; }
   std::string Inspect() {
     std::string res =  "[";
-    for (auto elem : elements) {
-      res += elem->Inspect() + ", ";
+    for (auto elem : *this) {
+      res += elem.Inspect() + ", ";
     }
     res += "]";
     return res;
   }
+  // a shared buffer only counts for the array left alone with it, a new
+  // slice does not count the buffer again and start a collection
+  size_t Size() {
+    return sizeof(Array) + (buffer->refs == 1 ? buffer->values.capacity() * sizeof(Value) : 0);
+  }
+
+  size_t Length() { return length; }
+  const Value* begin() { return buffer->values.data() + start; }
+  const Value* end() { return begin() + length; }
+  Value Get(size_t i) { return buffer->values[start + i]; }  // i < Length()
 
-  std::vector<Object*> elements;
+  // the changes, callers pass what they store to GarbageCollector::Remember
+  // and what they replace or remove to GarbageCollector::Forget.
+  // Set returns the element it replaces.
+  Value Set(size_t i, Value val);
+  // amortized O(1), the buffer grows by doubling
+  void Push(Value val);
+  Value Pop();  // NULL when empty
+  // the elements of this array and then of other, sharing the buffer of
+  // this one when other can be appended to it in place
+  Array* Concat(Array* other);
+
+ private:
+  void own();
+  bool atEnd() { return start + length == buffer->values.size(); }
+
+  ArrayBuffer* buffer;
+  size_t start;
+  size_t length;
 };
 
+// integers and strings as keys, with open addressing and linear probing.
+// the pairs stay in the order they were added, the table only holds their
+// positions next to the hash of the key, so a probe compares the keys only
+// when the hashes are equal, and growing does not hash the keys again.
+// a String key must not change while it is in the table, the evaluator
+// and the vm give the table its own copy unless the string is interned.
+// keys and values are tracked by the garbage collector on their own.
+class Hash : public Object {
+ public:
+  struct Pair {
+    Value key;  // unbound once the pair is deleted
+    Value value;
+    uint32_t hash;
+  };
+
+  Hash() : Object(), count(0) { }
+  ObjectType Type() { return HASH_OBJ; }
+  std::string Inspect();
+  size_t Size() { return sizeof(Hash) + pairs.capacity() * sizeof(Pair) + slots.capacity() * sizeof(Slot); }
+
+  static bool Hashable(Value key) { return key.IsInteger() || key.Is(STRING_OBJ); }
+  // the key has to be Hashable. unbound when it is not in the table.
+  Value Get(Value key);
+  // the value it replaces, unbound for a new key
+  Value Set(Value key, Value value);
+  // the value of the removed pair, unbound when there was none
+  Value Delete(Value key);
+  size_t Count() { return count; }
+
+  std::vector<Pair> pairs;  // deleted ones stay until the table grows
+
+ private:
+  static const int32_t EMPTY = -1;
+  static const int32_t DELETED = -2;  // a tombstone, probes go on past it
+  struct Slot {
+    uint32_t hash;
+    int32_t index;  // into pairs, or EMPTY or DELETED
+  };
+
+  static uint32_t hashOf(Value key);
+  long find(Value key, uint32_t hash);  // the slot of the key, or -1
+  void rehash();
+
+  std::vector<Slot> slots;  // a power of two, at most three quarters used
+  size_t count;  // pairs that are not deleted
+};
+
+class GarbageCollector;
+
+// a builtin allocates through the collector of the evaluator or the vm,
+// and calls Remember after it changes an object in place.
 class Builtin : public Object {
  public:
-  Builtin(Object* (*fn)(std::vector<Object*>&)) : Object(), function(fn) { }
+  Builtin(Value (*fn)(std::vector<Value>&, GarbageCollector&)) : Object(), function(fn) { }
   ~Builtin() {}
   ObjectType Type() { return BUILTIN_OBJ; }
   std::string Inspect() { return "builtin function"; }
+  size_t Size() { return sizeof(Builtin); }
 
-  Object* (*function)(std::vector<Object*>&);
+  Value (*function)(std::vector<Value>&, GarbageCollector&);
 };
 
-extern Null* __NULL;
-extern Boolean* __TRUE;
-extern Boolean* __FALSE;
-
 }  // namespace monkey
 
 
@@ -0,0 +1,35 @@
+#ifndef MONKEY_OPTIMIZER_H_
+#define MONKEY_OPTIMIZER_H_
+
+#include <vector>
+#include "ast.h"
+
+namespace monkey {
+
+// rewrites a parsed Program in place, before the Resolver runs.
+// operators on literals are folded into a literal, an if with a constant
+// condition loses the arm that cannot run, and the statements after a
+// return are dropped. only what gives the same result at runtime is
+// rewritten, anything that would be an error is left to the evaluator.
+// new nodes come from the arena of the Program, replaced ones stay there.
+class Optimizer {
+ public:
+  void Optimize(Program* program);
+ private:
+  void optimizeStatements(std::vector<Statement*>& statements);
+  void optimizeStatement(Statement* stmt);
+  Expression* optimize(Expression* exp);
+  Expression* foldPrefix(PrefixExpression* prefix);
+  Expression* foldInfix(InfixExpression* infix);
+  Expression* foldIf(IfExpression* ifExp);
+
+  Expression* newInteger(const Token& token, long long value);
+  Expression* newBoolean(const Token& token, bool value);
+  Expression* newString(const Token& token, const std::string& value);
+
+  Arena* arena;
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_OPTIMIZER_H_
@@ -3,7 +3,6 @@
 
 #include <vector>
 #include <string>
-#include <unordered_map>
 #include "lexer.h"
 #include "ast.h"
 
@@ -26,13 +25,54 @@ enum Precedence{
   INDEX,       // []
 };
 
-extern std::unordered_map<TokenType, Precedence> precedences;
+// indexed by TokenType, LOWEST for the tokens that are no infix operators
+constexpr Precedence precedences[TOKEN_TYPE_COUNT] = {
+  LOWEST,       // ILLEGAL
+  LOWEST,       // END
+  LOWEST,       // IDENT
+  LOWEST,       // INT
+  LOWEST,       // STRING
+  LOWEST,       // ASSIGN
+  SUM,          // PLUS
+  SUM,          // MINUS
+  LOWEST,       // BANG
+  PRODUCT,      // ASTERISK
+  PRODUCT,      // SLASH
+  PRODUCT,      // PERCENT
+  LESSGREATER,  // LT
+  LESSGREATER,  // GT
+  LESSGREATER,  // LE
+  LESSGREATER,  // GE
+  EQUALS,       // EQ
+  EQUALS,       // NE
+  LOWEST,       // COMMA
+  LOWEST,       // SEMICOLON
+  LOWEST,       // COLON
+  CALL,         // LPAREN
+  LOWEST,       // RPAREN
+  LOWEST,       // LBRACE
+  LOWEST,       // RBRACE
+  INDEX,        // LBRACKET
+  LOWEST,       // RBRACKET
+  LOWEST,       // REF
+  LOWEST,       // FUNCTION
+  LOWEST,       // LET
+  LOWEST,       // TRUE
+  LOWEST,       // FALSE
+  LOWEST,       // IF
+  LOWEST,       // ELSE
+  LOWEST,       // RETURN
+  LOWEST,       // WHILE
+};
+// a new TokenType needs an entry in the tables of the parser
+static_assert(TOKEN_TYPE_COUNT == 36, "update precedences, prefixParseFns and infixParseFns");
 
 class Parser {
  public:
   void New(Lexer& l);
   std::vector<std::string> Errors() { return errors; }
   Program* ParseProgram();
+  Program* ParseStatement();  // the next top level statement only, for streaming
  private:
   void nextToken();
   bool expectPeek(const TokenType& t);
@@ -56,6 +96,7 @@ class Parser {
   std::vector<Identifier*> parseFunctionParameters();
   Expression* parseFunctionLiteral();
   Expression* parseArrayLiteral();
+  Expression* parseHashLiteral();
   Expression* parseGroupedExpression();
   Expression* parseIfExpression();
   Expression* parseWhileExpression();
@@ -74,10 +115,11 @@ class Parser {
   Token curToken;
   Token peekToken;
   
-  std::unordered_map<TokenType, PrefixParseFn> prefixParseFns;
-  std::unordered_map<TokenType, InfixParseFn> infixParseFns;
+  static const PrefixParseFn prefixParseFns[TOKEN_TYPE_COUNT];
+  static const InfixParseFn infixParseFns[TOKEN_TYPE_COUNT];
 
   std::vector<std::string> errors;
+  Arena* arena;  // of the Program being parsed
 };
 
 }  // namespace monkey
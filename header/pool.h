@@ -0,0 +1,32 @@
+#ifndef MONKEY_POOL_H_
+#define MONKEY_POOL_H_
+
+#include <cstddef>
+
+namespace monkey {
+
+const size_t POOL_GRANULE = 8;  // objects are rounded up to this
+const size_t MAX_POOLED_SIZE = 128;  // bigger objects use the global new
+const size_t SLAB_SIZE = 64 * 1024;
+
+// a size class allocator for the objects of the garbage collector.
+// each size class has its own free list, refilled with a whole slab at once,
+// so that objects of the same class are next to each other in memory.
+// slabs are never given back, freed objects only return to their free list.
+class Pool {
+ public:
+  static void* Allocate(size_t size);
+  static void Free(void* p, size_t size);
+
+ private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+  static void refill(size_t cls);
+
+  static FreeNode* freeLists[MAX_POOLED_SIZE / POOL_GRANULE + 1];
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_POOL_H_
@@ -0,0 +1,89 @@
+#ifndef MONKEY_RESOLVER_H_
+#define MONKEY_RESOLVER_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include "ast.h"
+
+namespace monkey {
+
+// a variable of an enclosing function that a closure uses:
+// a slot of the function right around it, or one of that one's upvalues.
+struct Capture {
+  bool local;
+  int index;
+};
+
+// the layout of the slots of an Environment:
+// one Scope for the top level, and one for each FunctionLiteral.
+class Scope {
+ public:
+  int Define(const std::string& name) {
+    int slot = Find(name);
+    if (slot != -1)
+      return slot;
+    names.push_back(name);
+    index[name] = names.size() - 1;
+    return names.size() - 1;
+  }
+  int Find(const std::string& name) {
+    auto it = index.find(name);
+    return it == index.end() ? -1 : it->second;
+  }
+
+  int FindUpvalue(const std::string& name) {
+    auto it = std::find(upvalues.begin(), upvalues.end(), name);
+    return it == upvalues.end() ? -1 : it - upvalues.begin();
+  }
+  int AddUpvalue(const std::string& name, Capture capture) {
+    upvalues.push_back(name);
+    captures.push_back(capture);
+    return upvalues.size() - 1;
+  }
+  void AddCell(int slot) {
+    if (!IsCell(slot))
+      cells.push_back(slot);
+  }
+  bool IsCell(int slot) {
+    return std::find(cells.begin(), cells.end(), slot) != cells.end();
+  }
+
+  std::vector<std::string> names;
+  std::unordered_map<std::string, int> index;
+  // closures, all empty at the top level
+  Scope* enclosing = nullptr;  // the function around this one
+  std::vector<std::string> upvalues;  // names of the captured variables
+  std::vector<Capture> captures;  // where each upvalue comes from
+  std::vector<int> cells;  // slots captured by the functions inside
+};
+
+// give every Identifier a slot before the program runs, scoping is lexical.
+// parameters and the names defined by let or & anywhere in a function body
+// are slots of that function's Environment. a name of an enclosing function
+// is an upvalue, captured when the FunctionLiteral is evaluated, and the
+// slot of the enclosing function becomes a cell. any other name is a slot
+// of the top level, defined on first use so a function can call one that
+// is defined later.
+class Resolver {
+ public:
+  // the scope of the top level environment, shared by all the programs
+  // resolved by this resolver, so the repl keeps its globals between lines.
+  Scope* Globals() { return &globals; }
+  void Resolve(Program* program);
+ private:
+  void declare(Node* node, Scope* scope);
+  void resolve(Node* node, Scope* scope);
+  void resolveIdentifier(Identifier* ident, Scope* scope);
+  int resolveUpvalue(Scope* scope, const std::string& name);
+
+  Scope globals;
+  // the local variables of the functions being resolved, they turn
+  // into cells once the functions inside have been resolved
+  std::vector<Identifier*> locals;
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_RESOLVER_H_
@@ -0,0 +1,83 @@
+#ifndef MONKEY_VM_H_
+#define MONKEY_VM_H_
+
+#include <vector>
+#include "code.h"
+#include "object.h"
+#include "environment.h"
+#include "compiler.h"
+#include "gc.h"
+
+namespace monkey {
+
+class Frame {
+ public:
+  Function* fn;  // nullptr for the main program
+  Bytecode* code;
+  int ip;
+  int basePointer;  // first argument on the stack
+  Environment* env;
+};
+
+// a stack based virtual machine running the output of Compiler.
+// runtime errors stop the whole program and are returned by Run,
+// the same as an Error propagating to the top in the Evaluator.
+class VM {
+ public:
+  VM(Bytecode& bytecode, GCOptions options = GCOptions(), int maxDepth = DEFAULT_MAX_DEPTH) :
+      bytecode(&bytecode), globals(nullptr), stack(1024), sp(0), returned(false), maxDepth(maxDepth), gc(options) { }
+  // for streaming, every statement brings its own bytecode
+  VM(GCOptions options = GCOptions(), int maxDepth = DEFAULT_MAX_DEPTH) :
+      bytecode(nullptr), globals(nullptr), stack(1024), sp(0), returned(false), maxDepth(maxDepth), gc(options) { }
+  Value Run(Environment* env);
+  Value Run(Bytecode& code, Environment* env) {
+    bytecode = &code;
+    return Run(env);
+  }
+  // the last bytecode run stopped at a top level return
+  bool Returned() { return returned; }
+  long Allocations() { return gc.allocated; }
+  GCStats& Stats() { return gc.stats; }
+ private:
+  void push(Value obj) {
+    if (sp == (int)stack.size())
+      stack.resize(stack.size() * 2);
+    stack[sp++] = obj;
+  }
+  Value pop() { return stack[--sp]; }
+  Object* track(Object* obj);
+  Value unpin(Value val);
+  Value hashKey(Value key);
+  void markRoots(Object* extra);
+
+  Value executeBinaryOperation(Opcode op, Value left, Value right);
+  Value executeIntegerOperation(Opcode op, Value left, Value right);
+  Value executeStringOperation(Opcode op, Value left, Value right);
+  Value executeBangOperator(Value right);
+  Value executeMinusOperator(Value right);
+  Value executeIndexExpression(Value array, Value index);
+  Value executeSetIndex(Value array, Value index, Value val);
+  Object* callFunction(int argc);
+  void bindArguments(Function* fn, int argc);
+  void setVariable(Identifier* name, Value val);
+  Value unboundVariable(const std::string& name);
+  Object* newClosure(CompiledFunction* compiled);
+  void keepRunning(Value fn);
+  bool tailCall(int argc);
+  Value unwind(Value err);
+
+  Bytecode* bytecode;
+  Environment* globals;  // the environment given to Run
+  std::vector<Value> stack;
+  int sp;  // always points to the next free slot
+  bool returned;
+  // the frames of the calls, on the heap so only maxDepth limits
+  // recursion. a returning call leaves its Frame for the next one.
+  std::vector<Frame> frames;
+  int maxDepth;
+  GarbageCollector gc;
+};
+
+}  // namespace monkey
+
+#endif  // MONKEY_VM_H_
@@ -3,43 +3,246 @@
 #include <string.h>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
 #include "./header/lexer.h"
 #include "./header/parser.h"
 #include "./header/evaluator.h"
+#include "./header/resolver.h"
+#include "./header/compiler.h"
+#include "./header/vm.h"
+#include "./header/builtin.h"
+#include "./header/cache.h"
+#include "./header/optimizer.h"
 
-// from https://stackoverflow.com/a/1195690/5163915
-std::string readFile2(const std::string &fileName) {
-  std::ifstream ifs(fileName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+// the script is mapped read only and lexed straight from the mapped pages,
+// the tokens and the ast point into it until the program ends.
+// files that cannot be mapped, like pipes, are read into a buffer.
+class SourceFile {
+ public:
+  SourceFile() : data(nullptr), size(0), mapped(nullptr) { }
+  ~SourceFile() {
+    if (mapped != nullptr)
+      munmap(mapped, size);
+  }
+
+  bool Open(const std::string& fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        close(fd);
+        mapped = p;
+        data = (const char*)p;
+        size = st.st_size;
+        return true;
+      }
+    }
+    close(fd);
+    std::ifstream ifs(fileName.c_str(), std::ios::in | std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    buffer = ss.str();
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+  }
+
+  const char* data;
+  size_t size;
+
+ private:
+  void* mapped;
+  std::string buffer;
+};
+
+void usage() {
+  std::cout << "usage: monkey [--vm] [--stream] [--no-optimize] [--dump-ast] [--max-depth=calls] [--cache-dir=dir] [--gc-threshold=bytes] [--gc-growth=factor] [--gc-budget=objects] [--gc-stats] file" << std::endl;
+  std::cout << "  --vm                  compile to bytecode and run on the virtual machine" << std::endl;
+  std::cout << "  --stream              run each top level statement once it is parsed, then free it" << std::endl;
+  std::cout << "  --no-optimize         run the script as written, without folding constants and dead branches" << std::endl;
+  std::cout << "  --dump-ast            print the program after the optimizer instead of running it" << std::endl;
+  std::cout << "  --max-depth=calls     nested calls before a call fails with an error (MONKEY_MAX_DEPTH)" << std::endl;
+  std::cout << "  --cache-dir=dir       keep the parsed script in dir and reuse it while it is unchanged (MONKEY_CACHE_DIR)" << std::endl;
+  std::cout << "  --gc-threshold=bytes  allocated bytes before a collection (MONKEY_GC_THRESHOLD)" << std::endl;
+  std::cout << "  --gc-growth=factor    growth of the old generation before a major collection (MONKEY_GC_GROWTH)" << std::endl;
+  std::cout << "  --gc-budget=objects   objects traced or swept per slice, 0 for all at once (MONKEY_GC_BUDGET)" << std::endl;
+  std::cout << "  --gc-stats            report collections, the longest pause and heap size at exit (MONKEY_GC_STATS)" << std::endl;
+}
+
+// --cache-dir: the Program parsed from a script is kept in
+// dir/<hash of the source>.ast, later runs of the same source read it
+// instead of lexing and parsing. a missing, stale or broken file is
+// simply replaced, writing it is best effort.
+std::string cachePath(const std::string& dir, uint64_t hash) {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.ast", (unsigned long long)hash);
+  return dir + name;
+}
 
-  std::ifstream::pos_type fileSize = ifs.tellg();
-  ifs.seekg(0, std::ios::beg);
+monkey::Program* loadCached(const std::string& path, SourceFile& input, uint64_t hash) {
+  SourceFile cache;
+  if (!cache.Open(path))
+    return nullptr;
+  monkey::AstReader reader;
+  return reader.Read(cache.data, cache.size, input.data, input.size, hash);
+}
 
-  std::vector<char> bytes(fileSize);
-  ifs.read(bytes.data(), fileSize);
+// written under a temporary name first, so a concurrent run
+// never reads half a file
+void storeCached(const std::string& path, monkey::Program* program, SourceFile& input, uint64_t hash) {
+  monkey::AstWriter writer;
+  std::string data = writer.Write(program, input.data, input.size, hash);
+  std::string tmp = path + "." + std::to_string(getpid());
+  std::ofstream ofs(tmp.c_str(), std::ios::out | std::ios::binary);
+  ofs.write(data.data(), data.size());
+  ofs.close();
+  if (!ofs || rename(tmp.c_str(), path.c_str()) != 0)
+    unlink(tmp.c_str());
+}
 
-  return std::string(bytes.data(), fileSize);
+// the environment first, the command line overrides it
+void gcOptionsFromEnv(monkey::GCOptions& options, bool& stats) {
+  if (const char* threshold = getenv("MONKEY_GC_THRESHOLD"))
+    options.threshold = strtoull(threshold, nullptr, 10);
+  if (const char* growth = getenv("MONKEY_GC_GROWTH"))
+    options.growth = strtod(growth, nullptr);
+  if (const char* budget = getenv("MONKEY_GC_BUDGET"))
+    options.budget = strtol(budget, nullptr, 10);
+  if (const char* s = getenv("MONKEY_GC_STATS"))
+    stats = strcmp(s, "0") != 0;
 }
 
 int main(int argc, char* argv[]) {
-  assert(argc > 1);
-  std::string filename(argv[1]);
-  std::string input = readFile2(filename);
+  std::string filename;
+  bool useVM = false;
+  bool stream = false;
+  bool optimize = true;
+  bool dumpAst = false;
+  int maxDepth = monkey::DEFAULT_MAX_DEPTH;
+  if (const char* depth = getenv("MONKEY_MAX_DEPTH"))
+    maxDepth = atoi(depth);
+  std::string cacheDir;
+  if (const char* dir = getenv("MONKEY_CACHE_DIR"))
+    cacheDir = dir;
+  monkey::GCOptions gcOptions;
+  bool gcStats = false;
+  gcOptionsFromEnv(gcOptions, gcStats);
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--vm") {
+      useVM = true;
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "--no-optimize") {
+      optimize = false;
+    } else if (arg == "--dump-ast") {
+      dumpAst = true;
+    } else if (arg.compare(0, 12, "--max-depth=") == 0) {
+      maxDepth = atoi(arg.c_str() + 12);
+    } else if (arg.compare(0, 12, "--cache-dir=") == 0) {
+      cacheDir = arg.substr(12);
+    } else if (arg.compare(0, 15, "--gc-threshold=") == 0) {
+      gcOptions.threshold = strtoull(arg.c_str() + 15, nullptr, 10);
+    } else if (arg.compare(0, 12, "--gc-growth=") == 0) {
+      gcOptions.growth = strtod(arg.c_str() + 12, nullptr);
+    } else if (arg.compare(0, 12, "--gc-budget=") == 0) {
+      gcOptions.budget = strtol(arg.c_str() + 12, nullptr, 10);
+    } else if (arg == "--gc-stats") {
+      gcStats = true;
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      usage();
+      return 1;
+    } else {
+      filename = arg;
+    }
+  }
+  if (filename.empty() || maxDepth < 1 || gcOptions.growth < 1 || gcOptions.budget < 0) {
+    usage();
+    return 1;
+  }
+  SourceFile input;
+  if (!input.Open(filename)) {
+    std::cout << "cannot open " << filename << std::endl;
+    return 1;
+  }
   monkey::Lexer l;
   monkey::Parser p;
-  monkey::Evaluator e;
-  monkey::Environment* env = new monkey::Environment();
-  l.New(input);
+  monkey::Optimizer opt;
+  monkey::Resolver r;
+  monkey::Environment* env = new monkey::Environment(r.Globals());
+  l.New(input.data, input.size);
   p.New(l);
-  monkey::Program* program = p.ParseProgram();
-  if (p.Errors().size()) {
-    std::cout << "Syntax Error: " << std::endl;
-    for (auto error : p.Errors()) {
-      std::cout << error << std::endl;
+  // without --stream the whole script is one Program. with it every top
+  // level statement is parsed, resolved, run and freed on its own, only the
+  // nodes of the functions it created stay alive while they are referenced.
+  // the statements before a syntax error have already run by then.
+  // the cache only holds whole programs.
+  bool useCache = !cacheDir.empty() && !stream;
+  uint64_t hash = useCache ? monkey::SourceHash(input.data, input.size) : 0;
+  monkey::Program* cached = useCache ? loadCached(cachePath(cacheDir, hash), input, hash) : nullptr;
+  monkey::Evaluator e(gcOptions, maxDepth, !stream);
+  monkey::VM vm(gcOptions, maxDepth);
+  monkey::Value o;
+  bool done = false;
+  while (!done) {
+    monkey::Program* program = cached;
+    if (program == nullptr) {
+      program = stream ? p.ParseStatement() : p.ParseProgram();
+      if (program == nullptr)
+        break;
+      if (p.Errors().size()) {
+        std::cout << "Syntax Error: " << std::endl;
+        for (auto error : p.Errors()) {
+          std::cout << error << std::endl;
+        }
+        return 0;
+      }
+      if (useCache)
+        storeCached(cachePath(cacheDir, hash), program, input, hash);
     }
-    return 0;
+    // the cache keeps the program as parsed, it is optimized on every run
+    if (optimize)
+      opt.Optimize(program);
+    if (dumpAst) {
+      std::cout << program->String() << std::endl;
+      done = !stream;
+      delete program;
+      continue;
+    }
+    r.Resolve(program);
+    if (useVM) {
+      monkey::Compiler c(!stream);
+      c.Compile(program);
+      if (c.Errors().size()) {
+        std::cout << "Compile Error: " << std::endl;
+        for (auto error : c.Errors()) {
+          std::cout << error << std::endl;
+        }
+        return 0;
+      }
+      o = vm.Run(c.GetBytecode(), env);
+      done = vm.Returned();
+    } else {
+      o = e.Eval(program, env);
+      done = e.Returned();
+    }
+    done = done || !stream || monkey::isError(o);
+    delete program;
   }
-  monkey::Object* o = e.Eval(program, env);
+  if (dumpAst)
+    return 0;
+  monkey::GCStats& stats = useVM ? vm.Stats() : e.Stats();
   std::cout << std::endl << "return: " << std::endl;
-  std::cout << "type:  " << o->Type() << std::endl;
-  std::cout << "value: " << o->Inspect() << std::endl;
+  std::cout << "type:  " << o.Type() << std::endl;
+  std::cout << "value: " << o.Inspect() << std::endl;
+  if (gcStats)
+    std::cerr << stats.String();
 }
\ No newline at end of file
@@ -1,33 +1,51 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <deque>
 #include "./header/lexer.h"
 #include "./header/parser.h"
 #include "./header/evaluator.h"
 #include "./header/environment.h"
+#include "./header/resolver.h"
 
 void eval() {
   const std::string PROMPT = ">> ";
   monkey::Lexer l;
   monkey::Parser p;
   monkey::Evaluator e;
-  monkey::Environment* env = new monkey::Environment();
-  while(true) {ƒ
+  monkey::Resolver r;
+  monkey::Environment* env = new monkey::Environment(r.Globals());
+  // functions defined by a line are called by later lines,
+  // so the nodes of every line and the line they point into
+  // live until the end of the session.
+  std::vector<monkey::Program*> programs;
+  std::deque<std::string> lines;
+  while(true) {
     std::string line;
     std::cout << PROMPT;
-    std::getline(std::cin, line);
-    l.New(line);
+    if (!std::getline(std::cin, line))
+      break;
+    lines.push_back(line);
+    l.New(lines.back());
     p.New(l);
     monkey::Program* program = p.ParseProgram();
     if (p.Errors().size()) {
       for (auto error : p.Errors()) {
         std::cout << error << std::endl;
       }
+      delete program;
+      lines.pop_back();
       continue;
     }
-    monkey::Object* o = e.Eval(program, env);
-    std::cout << "type: " << o->Type() << std::endl;
-    std::cout << o->Inspect() << std::endl;
+    programs.push_back(program);
+    r.Resolve(program);
+    monkey::Value o = e.Eval(program, env);
+    std::cout << "type: " << o.Type() << std::endl;
+    std::cout << o.Inspect() << std::endl;
   }
+  std::cout << std::endl;
+  for (auto program : programs)
+    delete program;
 }
 
 int main() {
@@ -8,11 +8,12 @@ void sh() {
   while(true) {
     std::string line;
     std::cout << PROMPT;
-    std::getline(std::cin, line);
+    if (!std::getline(std::cin, line))
+      break;
     l.New(line);
     monkey::Token t = l.NextToken();
     while(t.type != monkey::END) {
-      std::cout << "Type: " << t.type << ", Literal: " << t.literal << std::endl;
+      std::cout << "Type: " << monkey::TokenTypeString(t.type) << ", Literal: " << t.literal.String() << std::endl;
       t = l.NextToken();
     }
   }
@@ -9,7 +9,8 @@ void sh() {
     while(true) {
         std::string line;
         std::cout << PROMPT;
-        std::getline(std::cin, line);
+        if (!std::getline(std::cin, line))
+            break;
         l.New(line);
         p.New(l);
         monkey::Program* program = p.ParseProgram();
@@ -19,6 +20,7 @@ void sh() {
             }
         } else
             std::cout << program->String() << std::endl;
+        delete program;
     }
 }
 
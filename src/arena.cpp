@@ -0,0 +1,14 @@
+#include "../header/arena.h"
+#include "../header/ast.h"
+
+namespace monkey {
+
+// the members of the nodes, like strings and vectors, still own memory
+Arena::~Arena() {
+  for (auto node : nodes)
+    node->~Node();
+  for (auto chunk : chunks)
+    ::operator delete(chunk);
+}
+
+}  // namespace monkey
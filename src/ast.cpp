@@ -1,4 +1,6 @@
 #include "../header/ast.h"
+#include "../header/resolver.h"
+#include "../header/object.h"
 
 namespace monkey{
 
@@ -29,8 +31,11 @@ std::string LetStatement::String() {
 }
 
 std::string RefStatement::String() {
-  std::string res = TokenLiteral() + 
-    name.String() + " = ";
+  std::string res = TokenLiteral() + name.String();
+  for(auto index : indexes) {
+    res += "[" + index->String() + "]";
+  }
+  res += " = ";
   if(value != nullptr) {
     res += value->String();
   }
@@ -87,6 +92,12 @@ std::string WhileExpression::String() {
   return res;
 }
 
+// the parameters and the body belong to the arena of the Program
+FunctionLiteral::~FunctionLiteral() {
+  delete scope;
+  delete compiled;
+}
+
 std::string FunctionLiteral::String() {
   std::string res = TokenLiteral() + " (";
   for(auto param : parameters) {
@@ -106,6 +117,15 @@ std::string ArrayLiteral::String() {
   return res;
 }
 
+std::string HashLiteral::String() {
+  std::string res = "{";
+  for(auto& pair : pairs) {
+    res += pair.first->String() + ": " + pair.second->String() + ", ";
+  }
+  res += "}";
+  return res;
+}
+
 std::string CallExpression::String() {
   std::string res = function->String() + "(";
   for(auto arg : arguments) {
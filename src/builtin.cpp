@@ -0,0 +1,244 @@
+#include "../header/builtin.h"
+#include "../header/gc.h"
+#include <iostream>
+
+namespace monkey {
+
+/*
+ * builtin
+ */
+
+Value print(std::vector<Value>& objs, GarbageCollector& /*gc*/) {
+  for (auto obj : objs) {
+    if(isError(obj))
+      return obj;
+    std::cout << obj.Inspect() << " ";
+  }
+  std::cout << std::endl;
+  return __NULL;
+}
+
+Value wrongArguments(std::vector<Value>& args, size_t want) {
+  return new Error("wrong number of arguments. got=" + std::to_string(args.size()) +
+      ", want=" + std::to_string(want));
+}
+
+// checks the arguments of keys, values, contains and delete
+Value hashArguments(const std::string& name, std::vector<Value>& args, size_t want) {
+  if (args.size() != want)
+    return wrongArguments(args, want);
+  if (!args[0].Is(HASH_OBJ))
+    return new Error("argument to `" + name + "` must be HASH, got " + args[0].Type());
+  if (want > 1 && !Hash::Hashable(args[1]))
+    return new Error("unusable as hash key: " + args[1].Type());
+  return __NULL;
+}
+
+// the keys in the order they were added. String keys are copied,
+// the table relies on its own ones not changing.
+Value keys(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = hashArguments("keys", args, 1);
+  if (isError(err))
+    return err;
+  std::vector<Value> elements;
+  for (auto& pair : ((Hash*)args[0].AsObject())->pairs) {
+    if (pair.key.IsUnbound())
+      continue;
+    Value key = pair.key;
+    if (key.IsObject() && !isPinned(key)) {
+      key = new String(((String*)key.AsObject())->value);
+      gc.Add(key.AsObject());
+    }
+    elements.push_back(key);
+  }
+  Array* array = new Array(elements);
+  gc.Add(array);
+  return array;
+}
+
+Value values(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = hashArguments("values", args, 1);
+  if (isError(err))
+    return err;
+  std::vector<Value> elements;
+  for (auto& pair : ((Hash*)args[0].AsObject())->pairs) {
+    if (!pair.key.IsUnbound())
+      elements.push_back(pair.value);
+  }
+  Array* array = new Array(elements);
+  gc.Add(array);
+  return array;
+}
+
+Value contains(std::vector<Value>& args, GarbageCollector& /*gc*/) {
+  Value err = hashArguments("contains", args, 2);
+  if (isError(err))
+    return err;
+  return ((Hash*)args[0].AsObject())->Get(args[1]).IsUnbound() ? __FALSE : __TRUE;
+}
+
+// the value that was removed, NULL if the key was not there
+Value deleteKey(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = hashArguments("delete", args, 2);
+  if (isError(err))
+    return err;
+  Value value = ((Hash*)args[0].AsObject())->Delete(args[1]);
+  gc.Forget(value);
+  return value.IsUnbound() ? __NULL : value;
+}
+
+// strings count their bytes, hashes their keys
+Value len(std::vector<Value>& args, GarbageCollector& /*gc*/) {
+  if (args.size() != 1)
+    return wrongArguments(args, 1);
+  if (args[0].Is(ARRAY_OBJ))
+    return Value::FromInteger(((Array*)args[0].AsObject())->Length());
+  if (args[0].Is(STRING_OBJ))
+    return Value::FromInteger(((String*)args[0].AsObject())->value.size());
+  if (args[0].Is(HASH_OBJ))
+    return Value::FromInteger(((Hash*)args[0].AsObject())->Count());
+  return new Error("argument to `len` not supported, got " + args[0].Type());
+}
+
+// checks the arguments of the array builtins, the first one is the array
+Value arrayArguments(const std::string& name, std::vector<Value>& args, size_t want) {
+  if (args.size() != want)
+    return wrongArguments(args, want);
+  if (!args[0].Is(ARRAY_OBJ))
+    return new Error("argument to `" + name + "` must be ARRAY, got " + args[0].Type());
+  return __NULL;
+}
+
+// appends in place and returns the array
+Value push(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = arrayArguments("push", args, 2);
+  if (isError(err))
+    return err;
+  ((Array*)args[0].AsObject())->Push(args[1]);
+  gc.Remember(args[0], args[1]);
+  return args[0];
+}
+
+// removes the last element in place and returns it, NULL when empty
+Value pop(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = arrayArguments("pop", args, 1);
+  if (isError(err))
+    return err;
+  Value last = ((Array*)args[0].AsObject())->Pop();
+  gc.Forget(last);
+  return last;
+}
+
+// the elements from start up to end, sharing the buffer of the array
+Value slice(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = arrayArguments("slice", args, 3);
+  if (isError(err))
+    return err;
+  if (!args[1].IsInteger() || !args[2].IsInteger())
+    return new Error("arguments to `slice` must be INTEGER, got " + args[1].Type() + " and " + args[2].Type());
+  Array* array = (Array*)args[0].AsObject();
+  int start = args[1].AsInteger();
+  int end = args[2].AsInteger();
+  if (start < 0 || start > end || end > (int)array->Length())
+    return new Error("slice [" + std::to_string(start) + ":" + std::to_string(end) + "] out of range");
+  Array* result = new Array(array, start, end - start);
+  gc.Add(result);
+  return result;
+}
+
+// all but the first element, sharing the buffer. NULL when empty.
+Value rest(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = arrayArguments("rest", args, 1);
+  if (isError(err))
+    return err;
+  Array* array = (Array*)args[0].AsObject();
+  if (array->Length() == 0)
+    return __NULL;
+  Array* result = new Array(array, 1, array->Length() - 1);
+  gc.Add(result);
+  return result;
+}
+
+// a new array, both arguments stay as they are
+Value concat(std::vector<Value>& args, GarbageCollector& gc) {
+  Value err = arrayArguments("concat", args, 2);
+  if (isError(err))
+    return err;
+  if (!args[1].Is(ARRAY_OBJ))
+    return new Error("argument to `concat` must be ARRAY, got " + args[1].Type());
+  Array* result = ((Array*)args[0].AsObject())->Concat((Array*)args[1].AsObject());
+  gc.Add(result);
+  return result;
+}
+
+// n elements that are all init itself, array(3, [0]) holds the same array 3 times
+Value array(std::vector<Value>& args, GarbageCollector& gc) {
+  if (args.size() != 2)
+    return wrongArguments(args, 2);
+  if (!args[0].IsInteger() || args[0].AsInteger() < 0)
+    return new Error("argument to `array` must be a non-negative INTEGER, got " + args[0].Inspect());
+  std::vector<Value> elements(args[0].AsInteger(), args[1]);
+  Array* result = new Array(elements);
+  gc.Add(result);
+  return result;
+}
+
+std::unordered_map<std::string, Builtin*> builtin({
+  {"print", new Builtin(*print)},
+  {"keys", new Builtin(*keys)},
+  {"values", new Builtin(*values)},
+  {"contains", new Builtin(*contains)},
+  {"delete", new Builtin(*deleteKey)},
+  {"len", new Builtin(*len)},
+  {"push", new Builtin(*push)},
+  {"pop", new Builtin(*pop)},
+  {"slice", new Builtin(*slice)},
+  {"rest", new Builtin(*rest)},
+  {"concat", new Builtin(*concat)},
+  {"array", new Builtin(*array)},
+});
+
+bool isTruthy(Value condition) {
+  if(condition == __TRUE) {
+    return true;
+  } else if(condition == __FALSE) {
+    return false;
+  } else if (condition == __NULL) {
+    return false;
+  } else if (condition.IsInteger() && condition.AsInteger() == 0) {
+    return false;
+  } else {
+    return true;
+  }
+}
+
+bool isError(Value o) {
+  return o.Is(ERROR_OBJ);
+}
+
+String* intern(const std::string& value) {
+  static std::unordered_map<std::string, String*> strings;
+  auto it = strings.find(value);
+  if (it != strings.end())
+    return it->second;
+  String* s = new String(value);
+  s->pinned = true;
+  strings[value] = s;
+  return s;
+}
+
+// all 256 are interned the first time one is needed
+String* charString(char ch) {
+  static String* table[256];
+  if (table[0] == nullptr) {
+    for (int i = 0; i < 256; i++)
+      table[i] = intern(std::string(1, (char)i));
+  }
+  return table[(uint8_t)ch];
+}
+
+bool isPinned(Value o) {
+  return o.IsObject() && o.AsObject()->pinned;
+}
+
+}  // namespace monkey
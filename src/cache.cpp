@@ -0,0 +1,438 @@
+#include "../header/cache.h"
+
+namespace monkey {
+
+// header: magic, version, source size and hash, then the statements.
+// bump the version whenever the nodes or this layout change.
+const char CACHE_MAGIC[8] = {'M', 'O', 'N', 'K', 'E', 'Y', 'A', 'S'};
+const uint32_t CACHE_VERSION = 3;
+const uint8_t NULL_NODE = 0xff;
+
+uint64_t SourceHash(const char* source, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (uint8_t)source[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/*
+ * writer
+ */
+// 7 bits per byte, the high bit says that more bytes follow
+void AstWriter::putVarint(uint64_t val) {
+  while (val >= 0x80) {
+    out.push_back((char)(val | 0x80));
+    val >>= 7;
+  }
+  out.push_back((char)val);
+}
+
+// the distance to the previous token is zigzag encoded, in preorder
+// an infix operator comes before its left operand
+void AstWriter::putToken(const Token& tok) {
+  size_t offset = tok.literal.data - source;
+  int64_t delta = (int64_t)offset - (int64_t)lastOffset;
+  lastOffset = offset;
+  put((uint8_t)tok.type);
+  putVarint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+  putVarint(tok.literal.size);
+}
+
+void AstWriter::putNode(Node* node) {
+  if (node == nullptr) {
+    put(NULL_NODE);
+    return;
+  }
+  put((uint8_t)node->Kind());
+  switch (node->Kind()) {
+  case IDENTIFIER_NODE:
+    putToken(((Identifier*)node)->token);
+    break;
+  case INTEGER_LITERAL_NODE:
+    putToken(((IntegerLiteral*)node)->token);
+    putVarint((uint32_t)((IntegerLiteral*)node)->value);
+    break;
+  case BOOLEAN_LITERAL_NODE:
+    putToken(((BooleanLiteral*)node)->token);
+    break;
+  case STRING_LITERAL_NODE:
+    putToken(((StringLiteral*)node)->token);
+    break;
+  case FUNCTION_LITERAL_NODE: {
+    FunctionLiteral* fn = (FunctionLiteral*)node;
+    putToken(fn->token);
+    putCount(fn->parameters.size());
+    for (auto param : fn->parameters)
+      putToken(param->token);
+    putNode(fn->body);
+    break;
+  }
+  case ARRAY_LITERAL_NODE:
+    putToken(((ArrayLiteral*)node)->token);
+    putCount(((ArrayLiteral*)node)->elements.size());
+    for (auto elem : ((ArrayLiteral*)node)->elements)
+      putNode(elem);
+    break;
+  case HASH_LITERAL_NODE:
+    putToken(((HashLiteral*)node)->token);
+    putCount(((HashLiteral*)node)->pairs.size());
+    for (auto& pair : ((HashLiteral*)node)->pairs) {
+      putNode(pair.first);
+      putNode(pair.second);
+    }
+    break;
+  case CALL_EXPRESSION_NODE:
+    putToken(((CallExpression*)node)->token);
+    putNode(((CallExpression*)node)->function);
+    putCount(((CallExpression*)node)->arguments.size());
+    for (auto arg : ((CallExpression*)node)->arguments)
+      putNode(arg);
+    break;
+  case INDEX_EXPRESSION_NODE:
+    putToken(((IndexExpression*)node)->token);
+    putNode(((IndexExpression*)node)->array);
+    putNode(((IndexExpression*)node)->index);
+    break;
+  case PREFIX_EXPRESSION_NODE:
+    putToken(((PrefixExpression*)node)->token);
+    putNode(((PrefixExpression*)node)->right);
+    break;
+  case INFIX_EXPRESSION_NODE:
+    putToken(((InfixExpression*)node)->token);
+    putNode(((InfixExpression*)node)->left);
+    putNode(((InfixExpression*)node)->right);
+    break;
+  case IF_EXPRESSION_NODE:
+    putToken(((IfExpression*)node)->token);
+    putNode(((IfExpression*)node)->condition);
+    putNode(((IfExpression*)node)->consequence);
+    putNode(((IfExpression*)node)->alternative);
+    break;
+  case WHILE_EXPRESSION_NODE:
+    putToken(((WhileExpression*)node)->token);
+    putNode(((WhileExpression*)node)->condition);
+    putNode(((WhileExpression*)node)->consequence);
+    break;
+  case LET_STATEMENT_NODE:
+    putToken(((LetStatement*)node)->token);
+    putToken(((LetStatement*)node)->name.token);
+    putNode(((LetStatement*)node)->value);
+    break;
+  case REF_STATEMENT_NODE:
+    putToken(((RefStatement*)node)->token);
+    putToken(((RefStatement*)node)->name.token);
+    putCount(((RefStatement*)node)->indexes.size());
+    for (auto index : ((RefStatement*)node)->indexes)
+      putNode(index);
+    putNode(((RefStatement*)node)->value);
+    break;
+  case RETURN_STATEMENT_NODE:
+    putToken(((ReturnStatement*)node)->token);
+    putNode(((ReturnStatement*)node)->returnValue);
+    break;
+  case EXPRESSION_STATEMENT_NODE:
+    putToken(((ExpressionStatement*)node)->token);
+    putNode(((ExpressionStatement*)node)->expression);
+    break;
+  case BLOCK_STATEMENT_NODE:
+    putToken(((BlockStatement*)node)->token);
+    putCount(((BlockStatement*)node)->statements.size());
+    for (auto stmt : ((BlockStatement*)node)->statements)
+      putNode(stmt);
+    break;
+  case PROGRAM_NODE:
+    break;
+  }
+}
+
+std::string AstWriter::Write(Program* program, const char* source, size_t size, uint64_t hash) {
+  this->source = source;
+  lastOffset = 0;
+  out.clear();
+  out.append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  put(CACHE_VERSION);
+  put((uint64_t)size);
+  put(hash);
+  putCount(program->statements.size());
+  for (auto stmt : program->statements)
+    putNode(stmt);
+  return out;
+}
+
+/*
+ * reader
+ * every read is checked against the end of the data,
+ * a truncated or corrupt file only makes Read fail.
+ */
+uint64_t AstReader::getVarint() {
+  uint64_t val = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte = get<uint8_t>();
+    val |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return val;
+  }
+  ok = false;
+  return 0;
+}
+
+Token AstReader::getToken() {
+  uint8_t type = get<uint8_t>();
+  uint64_t zigzag = getVarint();
+  uint64_t length = getVarint();
+  size_t offset = lastOffset + (int64_t)((zigzag >> 1) ^ -(zigzag & 1));
+  if (type >= TOKEN_TYPE_COUNT || offset > size || length > size - offset) {
+    ok = false;
+    return Token();
+  }
+  lastOffset = offset;
+  return Token((TokenType)type, source + offset, length);
+}
+
+size_t AstReader::getCount() {
+  uint64_t count = getVarint();
+  if (count > (size_t)(end - pos)) {  // every element takes at least a byte
+    ok = false;
+    return 0;
+  }
+  return count;
+}
+
+void AstReader::getIdentifier(Identifier* ident) {
+  ident->token = getToken();
+  ident->value = ident->token.literal;
+}
+
+// the parser never keeps a missing expression either
+Expression* AstReader::getExpression() {
+  Node* node = getNode();
+  if (node == nullptr) {
+    ok = false;
+    return nullptr;
+  }
+  switch (node->Kind()) {
+  case LET_STATEMENT_NODE:
+  case REF_STATEMENT_NODE:
+  case RETURN_STATEMENT_NODE:
+  case EXPRESSION_STATEMENT_NODE:
+  case BLOCK_STATEMENT_NODE:
+    ok = false;
+    return nullptr;
+  default:
+    return (Expression*)node;
+  }
+}
+
+// the parser never keeps a missing statement
+Statement* AstReader::getStatement() {
+  Node* node = getNode();
+  if (node == nullptr) {
+    ok = false;
+    return nullptr;
+  }
+  switch (node->Kind()) {
+  case LET_STATEMENT_NODE:
+  case REF_STATEMENT_NODE:
+  case RETURN_STATEMENT_NODE:
+  case EXPRESSION_STATEMENT_NODE:
+  case BLOCK_STATEMENT_NODE:
+    return (Statement*)node;
+  default:
+    ok = false;
+    return nullptr;
+  }
+}
+
+// only the alternative of an if may be missing
+BlockStatement* AstReader::getBlock(bool optional) {
+  Node* node = getNode();
+  if (node == nullptr ? !optional : node->Kind() != BLOCK_STATEMENT_NODE) {
+    ok = false;
+    return nullptr;
+  }
+  return (BlockStatement*)node;
+}
+
+Node* AstReader::getNode() {
+  uint8_t kind = get<uint8_t>();
+  if (!ok || kind == NULL_NODE)
+    return nullptr;
+  switch (kind) {
+  case IDENTIFIER_NODE: {
+    Identifier* ident = arena->New<Identifier>();
+    getIdentifier(ident);
+    return ident;
+  }
+  case INTEGER_LITERAL_NODE: {
+    IntegerLiteral* num = arena->New<IntegerLiteral>();
+    num->token = getToken();
+    num->value = (int32_t)(uint32_t)getVarint();
+    return num;
+  }
+  case BOOLEAN_LITERAL_NODE: {
+    BooleanLiteral* b = arena->New<BooleanLiteral>();
+    b->token = getToken();
+    b->value = b->token.type == TRUE;
+    return b;
+  }
+  case STRING_LITERAL_NODE: {
+    StringLiteral* s = arena->New<StringLiteral>();
+    s->token = getToken();
+    s->value = s->token.literal;
+    return s;
+  }
+  case FUNCTION_LITERAL_NODE: {
+    FunctionLiteral* fn = arena->New<FunctionLiteral>();
+    fn->token = getToken();
+    fn->arena = arena;
+    size_t count = getCount();
+    fn->parameters.reserve(count);
+    for (size_t i = 0; i < count && ok; i++) {
+      Identifier* param = arena->New<Identifier>();
+      getIdentifier(param);
+      fn->parameters.push_back(param);
+    }
+    fn->body = getBlock();
+    return fn;
+  }
+  case ARRAY_LITERAL_NODE: {
+    ArrayLiteral* array = arena->New<ArrayLiteral>();
+    array->token = getToken();
+    size_t count = getCount();
+    array->elements.reserve(count);
+    for (size_t i = 0; i < count && ok; i++)
+      array->elements.push_back(getExpression());
+    return array;
+  }
+  case HASH_LITERAL_NODE: {
+    HashLiteral* hash = arena->New<HashLiteral>();
+    hash->token = getToken();
+    size_t count = getCount();
+    hash->pairs.reserve(count);
+    for (size_t i = 0; i < count && ok; i++) {
+      Expression* key = getExpression();
+      hash->pairs.push_back(std::make_pair(key, getExpression()));
+    }
+    return hash;
+  }
+  case CALL_EXPRESSION_NODE: {
+    CallExpression* call = arena->New<CallExpression>();
+    call->token = getToken();
+    call->function = getExpression();
+    size_t count = getCount();
+    call->arguments.reserve(count);
+    for (size_t i = 0; i < count && ok; i++)
+      call->arguments.push_back(getExpression());
+    return call;
+  }
+  case INDEX_EXPRESSION_NODE: {
+    IndexExpression* index = arena->New<IndexExpression>();
+    index->token = getToken();
+    index->array = getExpression();
+    index->index = getExpression();
+    return index;
+  }
+  case PREFIX_EXPRESSION_NODE: {
+    PrefixExpression* prefix = arena->New<PrefixExpression>();
+    prefix->token = getToken();
+    prefix->op = prefix->token.literal;
+    prefix->right = getExpression();
+    return prefix;
+  }
+  case INFIX_EXPRESSION_NODE: {
+    InfixExpression* infix = arena->New<InfixExpression>();
+    infix->token = getToken();
+    infix->op = infix->token.literal;
+    infix->left = getExpression();
+    infix->right = getExpression();
+    return infix;
+  }
+  case IF_EXPRESSION_NODE: {
+    IfExpression* ifExp = arena->New<IfExpression>();
+    ifExp->token = getToken();
+    ifExp->condition = getExpression();
+    ifExp->consequence = getBlock();
+    ifExp->alternative = getBlock(true);
+    return ifExp;
+  }
+  case WHILE_EXPRESSION_NODE: {
+    WhileExpression* whileExp = arena->New<WhileExpression>();
+    whileExp->token = getToken();
+    whileExp->condition = getExpression();
+    whileExp->consequence = getBlock();
+    return whileExp;
+  }
+  case LET_STATEMENT_NODE: {
+    LetStatement* let = arena->New<LetStatement>();
+    let->token = getToken();
+    getIdentifier(&let->name);
+    let->value = getExpression();
+    return let;
+  }
+  case REF_STATEMENT_NODE: {
+    RefStatement* ref = arena->New<RefStatement>();
+    ref->token = getToken();
+    getIdentifier(&ref->name);
+    size_t count = getCount();
+    ref->indexes.reserve(count);
+    for (size_t i = 0; i < count && ok; i++)
+      ref->indexes.push_back(getExpression());
+    ref->value = getExpression();
+    return ref;
+  }
+  case RETURN_STATEMENT_NODE: {
+    ReturnStatement* ret = arena->New<ReturnStatement>();
+    ret->token = getToken();
+    ret->returnValue = getExpression();
+    return ret;
+  }
+  case EXPRESSION_STATEMENT_NODE: {
+    ExpressionStatement* stmt = arena->New<ExpressionStatement>();
+    stmt->token = getToken();
+    stmt->expression = getExpression();
+    return stmt;
+  }
+  case BLOCK_STATEMENT_NODE: {
+    BlockStatement* block = arena->New<BlockStatement>();
+    block->token = getToken();
+    size_t count = getCount();
+    block->statements.reserve(count);
+    for (size_t i = 0; i < count && ok; i++)
+      block->statements.push_back(getStatement());
+    return block;
+  }
+  default:
+    ok = false;
+    return nullptr;
+  }
+}
+
+Program* AstReader::Read(const char* data, size_t dataSize, const char* source, size_t size, uint64_t hash) {
+  pos = data;
+  end = data + dataSize;
+  this->source = source;
+  this->size = size;
+  lastOffset = 0;
+  ok = dataSize >= sizeof(CACHE_MAGIC) && memcmp(data, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0;
+  if (!ok)
+    return nullptr;
+  pos += sizeof(CACHE_MAGIC);
+  if (get<uint32_t>() != CACHE_VERSION || get<uint64_t>() != size ||
+      get<uint64_t>() != hash || !ok)
+    return nullptr;
+  Program* program = new Program();
+  arena = program->arena;
+  size_t count = getCount();
+  program->statements.reserve(count);
+  for (size_t i = 0; i < count && ok; i++)
+    program->statements.push_back(getStatement());
+  if (!ok || pos != end) {
+    delete program;
+    return nullptr;
+  }
+  return program;
+}
+
+}  // namespace monkey
@@ -0,0 +1,89 @@
+#include "../header/code.h"
+
+namespace monkey {
+
+std::vector<Definition> definitions({
+  {"OpConstant", {4}},
+  {"OpString", {4}},
+  {"OpPop", {}},
+  {"OpTrue", {}},
+  {"OpFalse", {}},
+  {"OpNull", {}},
+  {"OpAdd", {}},
+  {"OpSub", {}},
+  {"OpMul", {}},
+  {"OpDiv", {}},
+  {"OpMod", {}},
+  {"OpEqual", {}},
+  {"OpNotEqual", {}},
+  {"OpGreaterThan", {}},
+  {"OpLessThan", {}},
+  {"OpGreaterEqual", {}},
+  {"OpLessEqual", {}},
+  {"OpMinus", {}},
+  {"OpBang", {}},
+  {"OpJump", {4}},
+  {"OpJumpNotTruthy", {4}},
+  {"OpGetLocal", {4}},
+  {"OpSetLocal", {4}},
+  {"OpRefLocal", {4}},
+  {"OpGetGlobal", {4}},
+  {"OpSetGlobal", {4}},
+  {"OpRefGlobal", {4}},
+  {"OpGetCell", {4}},
+  {"OpSetCell", {4}},
+  {"OpRefCell", {4}},
+  {"OpGetUpvalue", {4}},
+  {"OpArray", {4}},
+  {"OpHash", {4}},
+  {"OpIndex", {}},
+  {"OpSetIndex", {}},
+  {"OpClosure", {4}},
+  {"OpCall", {4}},
+  {"OpTailCall", {4}},
+  {"OpReturnValue", {}},
+});
+
+Definition& Lookup(Opcode op) {
+  return definitions[op];
+}
+
+Instructions Make(Opcode op, std::vector<int> operands) {
+  Definition& def = Lookup(op);
+  Instructions ins;
+  ins.push_back(op);
+  for (size_t i = 0; i < def.operandWidths.size(); i++) {
+    uint32_t operand = operands[i];
+    for (int b = 0; b < def.operandWidths[i]; b++) {
+      ins.push_back((operand >> (8 * b)) & 0xff);
+    }
+  }
+  return ins;
+}
+
+int ReadOperand(const uint8_t* ins, int width) {
+  uint32_t operand = 0;
+  for (int b = 0; b < width; b++) {
+    operand |= (uint32_t)ins[b] << (8 * b);
+  }
+  return operand;
+}
+
+std::string InstructionsString(const Instructions& ins) {
+  std::string res;
+  size_t i = 0;
+  while (i < ins.size()) {
+    Definition& def = Lookup(ins[i]);
+    std::string line = std::to_string(i) + " " + def.name;
+    int offset = 1;
+    for (int width : def.operandWidths) {
+      line += " " + std::to_string(ReadOperand(&ins[i + offset], width));
+      offset += width;
+    }
+    res += line + "\n";
+    i += offset;
+  }
+  return res;
+}
+
+}  // namespace monkey
@@ -0,0 +1,258 @@
+#include "../header/compiler.h"
+#include "../header/builtin.h"
+
+namespace monkey {
+
+/*
+ * utility functions
+ */
+int Compiler::emit(Opcode op, std::vector<int> operands) {
+  Instructions ins = Make(op, operands);
+  Instructions& current = currentInstructions();
+  int pos = current.size();
+  current.insert(current.end(), ins.begin(), ins.end());
+  return pos;
+}
+
+int Compiler::addConstant(Value obj) {
+  std::vector<Value>& constants = scopes.back().constants;
+  constants.push_back(obj);
+  return constants.size() - 1;
+}
+
+// one of the get, set or ref opcodes, for where the variable lives
+void Compiler::emitVariable(Identifier* ident, Opcode local) {
+  int offset = 0;
+  switch (ident->kind) {
+  case GLOBAL_VARIABLE:
+    offset = OP_GET_GLOBAL - OP_GET_LOCAL;
+    break;
+  case CELL_VARIABLE:
+    offset = OP_GET_CELL - OP_GET_LOCAL;
+    break;
+  case UPVALUE_VARIABLE:
+    offset = OP_GET_UPVALUE - OP_GET_LOCAL;  // only ever read
+    break;
+  default:
+    break;
+  }
+  emit(local + offset, {ident->slot});
+}
+
+// backpatch the operand of a jump
+void Compiler::changeOperand(int pos, int operand) {
+  Instructions& current = currentInstructions();
+  Instructions ins = Make(current[pos], {operand});
+  for (size_t i = 0; i < ins.size(); i++) {
+    current[pos + i] = ins[i];
+  }
+}
+
+/*
+ * compile
+ */
+void Compiler::compileStatements(std::vector<Statement*>& statements, bool keep) {
+  if (statements.empty()) {
+    if (keep)
+      emit(OP_NULL);
+    return;
+  }
+  for (size_t i = 0; i < statements.size(); i++) {
+    compileStatement(statements[i], keep && i == statements.size() - 1);
+  }
+}
+
+void Compiler::compileStatement(Statement* stmt, bool keep) {
+  switch (stmt->Kind()) {
+  case LET_STATEMENT_NODE:
+    compileExpression(((LetStatement*)stmt)->value, true);
+    emitVariable(&((LetStatement*)stmt)->name, OP_SET_LOCAL);
+    if (keep)
+      emit(OP_NULL);
+    break;
+  case REF_STATEMENT_NODE: {
+    RefStatement* ref = (RefStatement*)stmt;
+    if (ref->indexes.empty()) {
+      compileExpression(ref->value, true);
+      emitVariable(&ref->name, OP_REF_LOCAL);
+    } else {  // &a[i][j] = v indexes a[i] and stores into it
+      compileExpression(&ref->name, true);
+      for (size_t i = 0; i + 1 < ref->indexes.size(); i++) {
+        compileExpression(ref->indexes[i], true);
+        emit(OP_INDEX);
+      }
+      compileExpression(ref->indexes.back(), true);
+      compileExpression(ref->value, true);
+      emit(OP_SET_INDEX);
+    }
+    if (keep)
+      emit(OP_NULL);
+    break;
+  }
+  case RETURN_STATEMENT_NODE: {
+    Expression* value = ((ReturnStatement*)stmt)->returnValue;
+    if (value->Kind() == CALL_EXPRESSION_NODE && scopes.size() > 1)
+      compileCall((CallExpression*)value, OP_TAIL_CALL);
+    else
+      compileExpression(value, true);
+    emit(OP_RETURN_VALUE);
+    break;
+  }
+  case EXPRESSION_STATEMENT_NODE:
+    compileExpression(((ExpressionStatement*)stmt)->expression, keep);
+    break;
+  case BLOCK_STATEMENT_NODE:
+    compileStatements(((BlockStatement*)stmt)->statements, keep);
+    break;
+  default:
+    errors.push_back("cannot compile statement " + stmt->Type());
+  }
+}
+
+void Compiler::compileExpression(Expression* exp, bool keep) {
+  switch (exp->Kind()) {
+  case INTEGER_LITERAL_NODE:
+    emit(OP_CONSTANT, {addConstant(Value::FromInteger(((IntegerLiteral*)exp)->value))});
+    break;
+  case STRING_LITERAL_NODE:
+    if (internLiterals) {
+      emit(OP_CONSTANT, {addConstant(intern(((StringLiteral*)exp)->value))});
+    } else {
+      std::vector<std::string>& strings = scopes.back().strings;
+      strings.push_back(((StringLiteral*)exp)->value);
+      emit(OP_STRING, {(int)strings.size() - 1});
+    }
+    break;
+  case BOOLEAN_LITERAL_NODE:
+    emit(((BooleanLiteral*)exp)->value ? OP_TRUE : OP_FALSE);
+    break;
+  case IDENTIFIER_NODE:
+    emitVariable((Identifier*)exp, OP_GET_LOCAL);
+    break;
+  case PREFIX_EXPRESSION_NODE: {
+    PrefixExpression* prefix = (PrefixExpression*)exp;
+    compileExpression(prefix->right, true);
+    if (prefix->op == "!") {
+      emit(OP_BANG);
+    } else if (prefix->op == "-") {
+      emit(OP_MINUS);
+    } else {
+      errors.push_back("unknown operator " + prefix->op);
+    }
+    break;
+  }
+  case INFIX_EXPRESSION_NODE: {
+    InfixExpression* infix = (InfixExpression*)exp;
+    compileExpression(infix->left, true);
+    compileExpression(infix->right, true);
+    const std::string& op = infix->op;
+    if (op == "+") emit(OP_ADD);
+    else if (op == "-") emit(OP_SUB);
+    else if (op == "*") emit(OP_MUL);
+    else if (op == "/") emit(OP_DIV);
+    else if (op == "%") emit(OP_MOD);
+    else if (op == "==") emit(OP_EQ);
+    else if (op == "!=") emit(OP_NE);
+    else if (op == ">") emit(OP_GT);
+    else if (op == "<") emit(OP_LT);
+    else if (op == ">=") emit(OP_GE);
+    else if (op == "<=") emit(OP_LE);
+    else errors.push_back("unknown operator " + op);
+    break;
+  }
+  case IF_EXPRESSION_NODE: {
+    IfExpression* ifExp = (IfExpression*)exp;
+    compileExpression(ifExp->condition, true);
+    int jumpNotTruthyPos = emit(OP_JUMP_NOT_TRUTHY, {0});
+    compileStatement(ifExp->consequence, keep);
+    if (ifExp->alternative == nullptr && !keep) {
+      changeOperand(jumpNotTruthyPos, currentInstructions().size());
+      return;
+    }
+    int jumpPos = emit(OP_JUMP, {0});
+    changeOperand(jumpNotTruthyPos, currentInstructions().size());
+    if (ifExp->alternative != nullptr) {
+      compileStatement(ifExp->alternative, keep);
+    } else {
+      emit(OP_NULL);
+    }
+    changeOperand(jumpPos, currentInstructions().size());
+    return;
+  }
+  case WHILE_EXPRESSION_NODE: {
+    WhileExpression* whileExp = (WhileExpression*)exp;
+    int loopStart = currentInstructions().size();
+    compileExpression(whileExp->condition, true);
+    int jumpNotTruthyPos = emit(OP_JUMP_NOT_TRUTHY, {0});
+    compileStatement(whileExp->consequence, false);
+    emit(OP_JUMP, {loopStart});
+    changeOperand(jumpNotTruthyPos, currentInstructions().size());
+    if (keep)
+      emit(OP_NULL);
+    return;
+  }
+  case ARRAY_LITERAL_NODE: {
+    ArrayLiteral* array = (ArrayLiteral*)exp;
+    for (auto elem : array->elements) {
+      compileExpression(elem, true);
+    }
+    emit(OP_ARRAY, {(int)array->elements.size()});
+    break;
+  }
+  case HASH_LITERAL_NODE: {
+    HashLiteral* hash = (HashLiteral*)exp;
+    for (auto& pair : hash->pairs) {
+      compileExpression(pair.first, true);
+      compileExpression(pair.second, true);
+    }
+    emit(OP_HASH, {(int)hash->pairs.size()});
+    break;
+  }
+  case INDEX_EXPRESSION_NODE:
+    compileExpression(((IndexExpression*)exp)->array, true);
+    compileExpression(((IndexExpression*)exp)->index, true);
+    emit(OP_INDEX);
+    break;
+  case FUNCTION_LITERAL_NODE:
+    compileFunction((FunctionLiteral*)exp);
+    break;
+  case CALL_EXPRESSION_NODE:
+    compileCall((CallExpression*)exp, OP_CALL);
+    break;
+  default:
+    errors.push_back("cannot compile expression " + exp->Type());
+    return;
+  }
+  if (!keep)
+    emit(OP_POP);
+}
+
+// op is OP_TAIL_CALL for return f(...) inside a function, the vm falls
+// back to OP_CALL when f is not the function that is running
+void Compiler::compileCall(CallExpression* call, Opcode op) {
+  compileExpression(call->function, true);
+  for (auto arg : call->arguments) {
+    compileExpression(arg, true);
+  }
+  emit(op, {(int)call->arguments.size()});
+}
+
+void Compiler::compileFunction(FunctionLiteral* fn) {
+  scopes.push_back(Bytecode());
+  compileStatements(fn->body->statements, true);
+  emit(OP_RETURN_VALUE);
+  Bytecode code = scopes.back();
+  scopes.pop_back();
+  // the literal owns it, a streamed statement may be freed before its functions
+  delete fn->compiled;
+  fn->compiled = new CompiledFunction(code, fn);
+  emit(OP_CLOSURE, {addConstant(fn->compiled)});
+}
+
+void Compiler::Compile(Program* program) {
+  compileStatements(program->statements, true);
+  emit(OP_RETURN_VALUE);
+  bytecode = scopes[0];
+}
+
+}  // namespace monkey
@@ -0,0 +1,39 @@
+#include "../header/environment.h"
+
+namespace monkey {
+
+Environment* Environment::freeList = nullptr;
+size_t Environment::freeCount = 0;
+
+// build with -DMONKEY_NO_POOL to check memory errors with a sanitizer
+#ifdef MONKEY_NO_POOL
+const bool REUSE_ENVIRONMENTS = false;
+#else
+const bool REUSE_ENVIRONMENTS = true;
+#endif
+
+Environment* Environment::NewEnclosedEnvironment(Scope* scope) {
+  Environment* inner = freeList;
+  if (inner != nullptr) {
+    freeList = inner->outer;
+    freeCount--;
+    inner->scope = scope;
+    inner->slots.assign(scope->names.size(), Value::Unbound());
+  } else {
+    inner = new Environment(scope);
+  }
+  inner->outer = this;
+  return inner;
+}
+
+void Environment::Release() {
+  if (!REUSE_ENVIRONMENTS || freeCount == MAX_FREE_ENVIRONMENTS) {
+    delete this;
+    return;
+  }
+  outer = freeList;
+  freeList = this;
+  freeCount++;
+}
+
+}  // namespace monkey
@@ -1,76 +1,51 @@
 #include "../header/evaluator.h"
-#include <iostream>
+#include "../header/builtin.h"
+#include <sys/resource.h>
 
 namespace monkey {
 
-/*
- * builtin
- */
-
-Object* print(std::vector<Object*>& objs) {
-  for (auto obj : objs) {
-    if(obj->Type() == ERROR_OBJ)
-      return obj;
-    std::cout << obj->Inspect() << " ";
-  }
-  std::cout << std::endl;
-  return __NULL;
+// three quarters of the stack limit, the rest is left for the
+// expressions of the innermost call and for the builtins
+size_t nativeStackLimit() {
+  struct rlimit rl;
+  size_t size = 8 << 20;
+  if (getrlimit(RLIMIT_STACK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+    size = rl.rlim_cur;
+  return size / 4 * 3;
 }
 
-std::unordered_map<std::string, Builtin*> builtin({
-  {"print", new Builtin(*print)}
-});
-
-bool isTruthy(Object* condition) {
-  if(condition == __TRUE) {
-    return true;
-  } else if(condition == __FALSE) {
-    return false;
-  } else if (condition == __NULL) {
-    return false;
-  } else if (condition->Type() == INTEGER_OBJ && ((Integer*)condition)->value == 0) {
-    return false;
-  } else {
-    return true;
-  }
+Evaluator::Evaluator(GCOptions options, int maxDepth, bool internLiterals) :
+    gc(options), tailCall(__NULL), maxDepth(maxDepth), stackLimit(nativeStackLimit()),
+    internLiterals(internLiterals) {
+  tailCall.pinned = true;
 }
 
-bool isError(Object* o) {
-  if(o != nullptr) {
-    return o->Type() == ERROR_OBJ;
-  }
-  return false;
-}
-
-Object* Evaluator::evalStatements(std::vector<Statement*> statements, Environment* env) {
-  Object* result;
+Value Evaluator::evalStatements(std::vector<Statement*>& statements, Environment* env) {
+  Value result = __NULL;
   for(auto stmt : statements) {
     result = Eval(stmt, env);
-    gc.Mark(result);  // mark the intermediate result
-    if (result->Type() == RETURN_VALUE_OBJ) {
-      gc.Mark(((ReturnValue*)result)->value);
-    }
-    gcCounter++;
-    if(gcCounter == 100) {
+    gc.Step([&]() {
+      gc.Mark(result);
+      gc.Mark(roots);
+      gc.Mark(closures);
+      gc.Mark(tailArgs);
       gc.Mark(env);
-      gc.Sweep();
-      gcCounter = 0;
-    }
-    if (result->Type() == RETURN_VALUE_OBJ || result->Type() == ERROR_OBJ)
+    });
+    if (result.Is(RETURN_VALUE_OBJ) || result.Is(ERROR_OBJ))
       return result;
   }
   return result;
 }
 
-Object* Evaluator::evalBangOperatorExpression(Object* right) {
+Value Evaluator::evalBangOperatorExpression(Value right) {
   if (right == __TRUE) {
     return __FALSE;
   } else if (right == __FALSE) {
     return __TRUE;
   } else if (right == __NULL) {
     return __TRUE;
-  } else if (right->Type() == INTEGER_OBJ) {
-    if(((Integer*)right)->value == 0) {
+  } else if (right.IsInteger()) {
+    if(right.AsInteger() == 0) {
       return __TRUE;
     } else {
       return __FALSE;
@@ -80,15 +55,14 @@ Object* Evaluator::evalBangOperatorExpression(Object* right) {
   }
 }
 
-Object* Evaluator::evalMinusPrefixExpression(Object* right) {
-  if(right->Type() == INTEGER_OBJ) {
-    Integer* i = new Integer(-((Integer*)right)->value);
-    return i;
+Value Evaluator::evalMinusPrefixExpression(Value right) {
+  if(right.IsInteger()) {
+    return Value::FromInteger(-right.AsInteger());
   }
-  return new Error("unknown operator: -" +  right->Type());
+  return new Error("unknown operator: -" +  right.Type());
 }
 
-Object* Evaluator::evalPrefixExpression(std::string op, Object* right) {
+Value Evaluator::evalPrefixExpression(std::string op, Value right) {
   if(op == "!") {
     return evalBangOperatorExpression(right);
   } else if (op == "-") {
@@ -98,24 +72,23 @@ Object* Evaluator::evalPrefixExpression(std::string op, Object* right) {
   }
 }
 
-Object* Evaluator::evalIntegerInfixExpression(std::string op, Object* left, Object* right) {
-  int leftVal = ((Integer*)left)->value;
-  int rightVal = ((Integer*)right)->value;
-    Object* res;
+Value Evaluator::evalIntegerInfixExpression(std::string op, Value left, Value right) {
+  int leftVal = left.AsInteger();
+  int rightVal = right.AsInteger();
   if(op == "+") {
-    res = new Integer(leftVal + rightVal);
+    return Value::FromInteger(leftVal + rightVal);
   }
   else if(op == "-") {
-    res = new Integer(leftVal - rightVal);
+    return Value::FromInteger(leftVal - rightVal);
   }
   else if(op == "*") {
-    res = new Integer(leftVal * rightVal);
+    return Value::FromInteger(leftVal * rightVal);
   }
   else if(op == "/" && rightVal != 0) {
-    res = new Integer(leftVal / rightVal);
+    return Value::FromInteger(leftVal / rightVal);
   }
   else if(op == "%" && rightVal != 0) {
-    res = new Integer(leftVal % rightVal);
+    return Value::FromInteger(leftVal % rightVal);
   }
   else if(op == "==") {
     return leftVal == rightVal ? __TRUE : __FALSE;
@@ -136,193 +109,450 @@ Object* Evaluator::evalIntegerInfixExpression(std::string op, Object* left, Obje
     return leftVal <= rightVal ? __TRUE : __FALSE;
   }
   else {
-    return new Error("unknown operator: " + left->Type() + " " + op + " " +  right->Type());
-  }
-  gc.Add(res);
-  return res;
+    return new Error("unknown operator: " + left.Type() + " " + op + " " +  right.Type());
   }
+}
 
-Object* Evaluator::evalStringInfixExpression(std::string op, Object* left, Object* right) {
-  std::string leftVal = ((String*)left)->value;
-  std::string rightVal = ((String*)right)->value;
+Value Evaluator::evalStringInfixExpression(std::string op, Value left, Value right) {
+  std::string leftVal = ((String*)left.AsObject())->value;
+  std::string rightVal = ((String*)right.AsObject())->value;
   Object* res;
   if(op == "+") {
     res = new String(leftVal + rightVal);
   } else {
-    return new Error("unknown operator: " + left->Type() + " " + op + " " +  right->Type());
+    return new Error("unknown operator: " + left.Type() + " " + op + " " +  right.Type());
   }
   gc.Add(res);
   return res;
 }
 
-Object* Evaluator::evalInfixExpression(std::string op, Object* left, Object* right) {
-  if (left->Type() == INTEGER_OBJ && right->Type() == INTEGER_OBJ) {
+Value Evaluator::evalInfixExpression(std::string op, Value left, Value right) {
+  if (left.IsInteger() && right.IsInteger()) {
     return evalIntegerInfixExpression(op, left, right);
-  } else if (left->Type() == STRING_OBJ && right->Type() == STRING_OBJ) {
+  } else if (left.Is(STRING_OBJ) && right.Is(STRING_OBJ)) {
     return evalStringInfixExpression(op, left, right);
   } else if(left == __NULL || right == __NULL) {
     return __NULL;
-  } else if (left->Type() != right->Type()) {
+  } else if (left.Type() != right.Type()) {
     return new Error(
-        "type mismatch: " + left->Type() + " " + op + " " +  right->Type());
+        "type mismatch: " + left.Type() + " " + op + " " +  right.Type());
   } else if(op == "==") {
     return left == right ? __TRUE : __FALSE;
   } else if(op == "!=") {
     return left != right ? __TRUE : __FALSE;
   } else {
     return new Error(
-        "unknown operator: " + left->Type() + " " + op + " " +  right->Type());
+        "unknown operator: " + left.Type() + " " + op + " " +  right.Type());
   }
 }
 
-Environment* Evaluator::extendedFunctionEnv(Function* fn, std::vector<Object*>& args, Environment* outer) {
-  Environment* env = outer->NewEnclosedEnvironment();
-  for(int i=0; i<args.size(); i++) {
-    env->Set(fn->parameters[i]->value, args[i]);
-  }
+// interned literals are shared, give the variable its own copy
+Value Evaluator::unpin(Value val) {
+  if (val.Is(RETURN_VALUE_OBJ))
+    val = ((ReturnValue*)val.AsObject())->value;
+  if (!isPinned(val))
+    return val;
+  String* s = new String(((String*)val.AsObject())->value);
+  gc.Add(s);
+  return s;
+}
+
+// outer is the environment of the caller, only for the garbage collector
+Environment* Evaluator::extendedFunctionEnv(Function* fn, std::vector<Value>& args, Environment* outer) {
+  Environment* env = outer->NewEnclosedEnvironment(fn->literal->scope);
+  bindArguments(fn, args.data(), env);
   return env;
 }
 
-Object* Evaluator::evalCallExpression(Object* fn, std::vector<Object*>& args, Environment* env) {
-  if(fn->Type() != FUNCTION_OBJ && fn->Type() != BUILTIN_OBJ) {
-    return new Error("not a function: " + fn->Type());
+// a fresh Cell for every variable the closures inside capture,
+// then the parameters
+void Evaluator::bindArguments(Function* fn, const Value* args, Environment* env) {
+  for (int slot : fn->literal->scope->cells) {
+    Cell* cell = new Cell();
+    gc.Add(cell);
+    env->slots[slot] = cell;
+  }
+  std::vector<Identifier*>& parameters = fn->literal->parameters;
+  for (size_t i = 0; i < parameters.size(); i++)
+    setVariable(parameters[i], unpin(args[i]), env);
+}
+
+Value Evaluator::setVariable(Identifier* name, Value val, Environment* env) {
+  if (name->kind == GLOBAL_VARIABLE)
+    return globals->SetSlot(name->slot, val);
+  if (name->kind == LOCAL_VARIABLE)
+    return env->SetSlot(name->slot, val);
+  Cell* cell = (Cell*)env->slots[name->slot].AsObject();
+  gc.Forget(cell->value);
+  cell->value = val;
+  gc.Remember(cell, val);
+  return __NULL;
+}
+
+Value Evaluator::refSetVariable(Identifier* name, Value val, Environment* env) {
+  Value result;
+  if (name->kind == CELL_VARIABLE) {
+    Cell* cell = (Cell*)env->slots[name->slot].AsObject();
+    gc.Forget(cell->value);
+    keepRunning(cell->value);
+    result = Environment::RefSet(cell->value, val, name->value);
+    gc.Remember(cell, cell->value);
+    gc.Remember(cell->value);  // a function may have been changed in place
+    return result;
+  }
+  Environment* target = name->kind == GLOBAL_VARIABLE ? globals : env;
+  if (name->slot < (int)target->slots.size()) {
+    gc.Forget(target->slots[name->slot]);  // a function may be changed in place
+    keepRunning(target->slots[name->slot]);
+  }
+  result = target->RefSetSlot(name->slot, val);
+  if (name->slot < (int)target->slots.size())
+    gc.Remember(target->slots[name->slot]);  // a function may have been changed in place
+  return result;
+}
+
+// before &f = g changes f in place. the calls of f that are running go on
+// with a copy, which keeps their upvalues and the arena of their ast,
+// a streamed statement may have held the last other reference to it.
+void Evaluator::keepRunning(Value fn) {
+  if (!fn.Is(FUNCTION_OBJ))
+    return;
+  Function* copy = nullptr;
+  for (auto& closure : closures) {
+    if (closure != fn)
+      continue;
+    if (copy == nullptr) {
+      copy = ((Function*)fn.AsObject())->Copy();
+      gc.Add(copy);
+    }
+    closure = copy;
+  }
+}
+
+// the upvalues are the cells of the running call, or its own upvalues
+Function* Evaluator::newClosure(FunctionLiteral* literal, Environment* env) {
+  Function* fn = new Function(literal);
+  for (auto& capture : literal->scope->captures) {
+    if (capture.local)
+      fn->upvalues.push_back(env->slots[capture.index]);
+    else
+      fn->upvalues.push_back(((Function*)closures.back().AsObject())->upvalues[capture.index]);
+  }
+  gc.Add(fn);
+  return fn;
+}
+
+Value Evaluator::evalCallExpression(Value callee, std::vector<Value>& args, Environment* env) {
+  if(!callee.Is(FUNCTION_OBJ) && !callee.Is(BUILTIN_OBJ)) {
+    return new Error("not a function: " + callee.Type());
   }
+  Object* fn = callee.AsObject();
   if(fn->Type() == BUILTIN_OBJ) {
-    return ((Builtin*)fn)->function(args);
+    return ((Builtin*)fn)->function(args, gc);
   }
-  if(((Function*)fn)->parameters.size() != args.size()) {
+  if(((Function*)fn)->literal->parameters.size() != args.size()) {
     return new Error("argument length(" + std::to_string(args.size()) +
         ") not equal to parameter length (" 
-        + std::to_string(((Function*)fn)->parameters.size()) + ")");
-  }
+        + std::to_string(((Function*)fn)->literal->parameters.size()) + ")");
+  }
+  char here;
+  if (depth >= maxDepth)
+    return new Error("maximum call depth (" + std::to_string(maxDepth) + ") exceeded");
+  if (stackBase != nullptr && stackBase - &here > (ptrdiff_t)stackLimit)
+    return new Error("stack overflow at call depth " + std::to_string(depth));
+  depth++;
+  FunctionLiteral* literal = ((Function*)fn)->literal;
   Environment* extendedEnv = extendedFunctionEnv((Function*)fn, args, env);
-  Object* evaluated = Eval(((Function*)fn)->body, extendedEnv);
-  delete extendedEnv;
-  if(evaluated->Type() == RETURN_VALUE_OBJ) {
-    return ((ReturnValue*)evaluated)->value;
+  closures.push_back(fn);
+  Value evaluated = Eval(literal->body, extendedEnv);
+  // the same literal, so the same slots. the callee may be another
+  // closure of it, with its own upvalues.
+  while (evaluated == Value(&tailCall)) {
+    closures.back() = tailArgs[0];
+    extendedEnv->slots.assign(literal->scope->names.size(), Value::Unbound());
+    bindArguments((Function*)tailArgs[0].AsObject(), tailArgs.data() + 1, extendedEnv);
+    tailArgs.clear();
+    evaluated = Eval(literal->body, extendedEnv);
+  }
+  closures.pop_back();
+  depth--;
+  extendedEnv->Release();
+  if(evaluated.Is(RETURN_VALUE_OBJ)) {
+    return ((ReturnValue*)evaluated.AsObject())->value;
   }
   return evaluated;
 }
 
-Object* Evaluator::evalArrayIndexExpression(Array* array, Integer* index) {
-  int i = index->value;
-  auto arr = array->elements;
-  try {
-    return arr[i];
-  } catch (const std::out_of_range e) {
-    return new Error("index " + index->Inspect() + " out of range");
-  }
+// tail is set for return f(...), which may reuse the running call of f
+Value Evaluator::evalCall(CallExpression* call, Environment* env, bool tail) {
+  Value function = Eval(call->function, env);
+  if(isError(function))
+    return function;
+
+  size_t base = roots.size();
+  roots.push_back(function);
+  std::vector<Value> args;
+  for(auto* argument : call->arguments) {  // for convenience, using pass by value
+    Value arg = Eval(argument, env);
+    if(isError(arg)) {
+      roots.resize(base);
+      return arg;
+    }
+    roots.push_back(arg);
+    args.push_back(arg);
+  }
+  FunctionLiteral* literal = function.Is(FUNCTION_OBJ) ? ((Function*)function.AsObject())->literal : nullptr;
+  if (tail && literal == ((Function*)closures.back().AsObject())->literal &&
+      literal->parameters.size() == args.size()) {
+    tailArgs.assign(roots.begin() + base, roots.end());
+    roots.resize(base);
+    return &tailCall;
+  }
+  Value result = evalCallExpression(function, args, env);
+  roots.resize(base);
+  return result;
 }
 
-Object* Evaluator::evalStringIndexExpression(String* array, Integer* index) {
-  int i = index->value;
-  auto arr = array->value;
-  try {
-    return new String(std::string(1, arr[i]));
-  } catch (const std::out_of_range e) {
-    return new Error("index " + index->Inspect() + " out of range");
-  }
+// the unsigned compare also catches negative indexes
+Value Evaluator::evalArrayIndexExpression(Array* array, Value index) {
+  size_t i = (size_t)index.AsInteger();
+  if (i >= array->Length())
+    return new Error("index " + index.Inspect() + " out of range");
+  return array->Get(i);
+}
+
+// a character is one of the shared strings of charString, no allocation
+Value Evaluator::evalStringIndexExpression(String* array, Value index) {
+  std::string& value = array->value;
+  size_t i = (size_t)index.AsInteger();
+  if (i >= value.size())
+    return new Error("index " + index.Inspect() + " out of range");
+  return charString(value[i]);
+}
+
+// a missing key gives NULL
+Value Evaluator::evalHashIndexExpression(Hash* hash, Value key) {
+  if (!Hash::Hashable(key))
+    return new Error("unusable as hash key: " + key.Type());
+  Value value = hash->Get(key);
+  return value.IsUnbound() ? __NULL : value;
 }
 
-Object* Evaluator::evalIndexExpression(Object* array, Object* index, Environment* env) {
-  if (array->Type() == ARRAY_OBJ && index->Type() == INTEGER_OBJ)
-    return evalArrayIndexExpression((Array*)array, (Integer*)index);
-  if (array->Type() == STRING_OBJ && index->Type() == INTEGER_OBJ)
-    return evalStringIndexExpression((String*)array, (Integer*)index);
+Value Evaluator::evalIndexExpression(Value array, Value index, Environment* env) {
+  if (array.Is(ARRAY_OBJ) && index.IsInteger())
+    return evalArrayIndexExpression((Array*)array.AsObject(), index);
+  if (array.Is(STRING_OBJ) && index.IsInteger())
+    return evalStringIndexExpression((String*)array.AsObject(), index);
+  if (array.Is(HASH_OBJ))
+    return evalHashIndexExpression((Hash*)array.AsObject(), index);
   else {
-    return new Error("index operator not supported: " + array->Type());
+    return new Error("index operator not supported: " + array.Type());
   }
 }
 
-Object* Evaluator::evalIdentifier(std::string name, Environment* env) {
-  Object* obj =  env->Get(name);
-  if (obj->Type() == ERROR_OBJ && builtin.find(name) != builtin.end()) {
-    return builtin[name];
+// &a[i][j] = v: a[i] is looked up like an index expression, then v is
+// stored into it in place. the containers stay on the roots, the value
+// may drop the last other reference to them.
+Value Evaluator::evalIndexAssignment(RefStatement* ref, Environment* env) {
+  size_t last = ref->indexes.size() - 1;
+  Value container = evalIdentifier(&ref->name, env);
+  for (size_t i = 0; i < last && !isError(container); i++) {
+    roots.push_back(container);
+    Value index = Eval(ref->indexes[i], env);
+    roots.pop_back();
+    container = isError(index) ? index : evalIndexExpression(container, index, env);
+  }
+  if (isError(container))
+    return container;
+  roots.push_back(container);
+  Value index = Eval(ref->indexes[last], env);
+  if (isError(index)) {
+    roots.pop_back();
+    return index;
+  }
+  roots.push_back(index);
+  Value val = Eval(ref->value, env);
+  Value result = isError(val) ? val : setIndex(container, index, unpin(val));
+  roots.resize(roots.size() - 2);
+  return result;
+}
+
+Value Evaluator::setIndex(Value container, Value index, Value val) {
+  if (container.Is(ARRAY_OBJ) && index.IsInteger()) {
+    Array* array = (Array*)container.AsObject();
+    size_t i = (size_t)index.AsInteger();
+    if (i >= array->Length())
+      return new Error("index " + index.Inspect() + " out of range");
+    gc.Forget(array->Set(i, val));
+  } else if (container.Is(HASH_OBJ)) {
+    Value key = hashKey(index);
+    if (isError(key))
+      return key;
+    gc.Forget(((Hash*)container.AsObject())->Set(key, val));
+    gc.Remember(container, key);
+  } else {
+    return new Error("index assignment not supported: " + container.Type());
   }
-  return obj;
+  gc.Remember(container, val);
+  return __NULL;
+}
+
+// a String key is copied unless it is interned, so that a reference
+// assignment to the string cannot change the key inside the table
+Value Evaluator::hashKey(Value key) {
+  if (!Hash::Hashable(key))
+    return new Error("unusable as hash key: " + key.Type());
+  if (!key.IsObject() || isPinned(key))
+    return key;
+  String* s = new String(((String*)key.AsObject())->value);
+  gc.Add(s);
+  return s;
 }
 
-Object* Evaluator::evalProgram(Program* program, Environment* env) {
-  Object* o = evalStatements(program->statements, env);
-  if (o->Type() == RETURN_VALUE_OBJ) {  // unwrap return value
-    return ((ReturnValue*)o)->value;
+// keys and values wait on the roots until all of them are evaluated,
+// a later pair with the same key wins
+Value Evaluator::evalHashLiteral(HashLiteral* literal, Environment* env) {
+  size_t base = roots.size();
+  for (auto& pair : literal->pairs) {
+    Value key = Eval(pair.first, env);
+    if (!isError(key))
+      key = hashKey(key);
+    if (isError(key)) {
+      roots.resize(base);
+      return key;
+    }
+    roots.push_back(key);
+    Value value = Eval(pair.second, env);
+    if (isError(value)) {
+      roots.resize(base);
+      return value;
+    }
+    roots.push_back(unpin(value));
+  }
+  Hash* hash = new Hash();
+  for (size_t i = base; i < roots.size(); i += 2)
+    hash->Set(roots[i], roots[i + 1]);
+  roots.resize(base);
+  gc.Add(hash);
+  return hash;
+}
+
+// a variable that is not bound yet, like x in let x = x + 1,
+// is the top level one of the same name, or a builtin
+Value Evaluator::evalIdentifier(Identifier* ident, Environment* env) {
+  Value obj;
+  switch (ident->kind) {
+  case GLOBAL_VARIABLE:
+    obj = globals->GetSlot(ident->slot);
+    break;
+  case LOCAL_VARIABLE:
+    obj = env->GetSlot(ident->slot);
+    break;
+  case CELL_VARIABLE:
+    obj = ((Cell*)env->slots[ident->slot].AsObject())->value;
+    break;
+  case UPVALUE_VARIABLE:
+    obj = ((Cell*)((Function*)closures.back().AsObject())->upvalues[ident->slot].AsObject())->value;
+    break;
+  }
+  if (!obj.IsUnbound())
+    return obj;
+  obj = globals->Get(ident->value);
+  if (!obj.IsUnbound())
+    return obj;
+  auto it = builtin.find(ident->value);
+  if (it != builtin.end())
+    return it->second;
+  return new Error("identifier not found: " + ident->value);
+}
+
+Value Evaluator::evalProgram(Program* program, Environment* env) {
+  char here;
+  stackBase = &here;
+  globals = env;
+  Value o = evalStatements(program->statements, env);
+  returned = o.Is(RETURN_VALUE_OBJ);
+  if (returned) {  // unwrap return value
+    return ((ReturnValue*)o.AsObject())->value;
   }
   return o;
 }
 
-Object* Evaluator::Eval(Node* node, Environment* env) {
-  std::string type = node->Type();
-  if (type == "Program") {
+Value Evaluator::Eval(Node* node, Environment* env) {
+  switch (node->Kind()) {
+  case PROGRAM_NODE:
     return evalProgram((Program*)node, env);
-  } else if (type == "IntegerLiteral") {
-    Integer* i = new Integer(((IntegerLiteral*)node)->value);
-    gc.Add(i);
-    return i;
-  } else if (type == "BooleanLiteral") {
+  case INTEGER_LITERAL_NODE:
+    return Value::FromInteger(((IntegerLiteral*)node)->value);
+  case BOOLEAN_LITERAL_NODE:
     return ((BooleanLiteral*)node)->value ? __TRUE : __FALSE;
-  } else if (type == "StringLiteral") {
-    String* s = new String(((StringLiteral*)node)->value);
-    gc.Add(s);
-    return s;
-  } else if (type == "Identifier") {
-    return evalIdentifier(((Identifier*)node)->value, env);
-  } else if (type == "FunctionLiteral") {
-    Function* f =  new Function(((FunctionLiteral*)node)->parameters, ((FunctionLiteral*)node)->body);
-    gc.Add(f);
-    return f;
-  } else if (type == "CallExpression") {
-    Object* function = Eval(((CallExpression*)node)->function, env);
-    if(isError(function))
-      return function;
-    
-    std::vector<Object*> args;
-    for(auto* argument : ((CallExpression*)node)->arguments) {  // for convenience, using pass by value
-      Object* arg = Eval(argument, env);
-      if(isError(arg))
-      return arg;
-      args.push_back(arg);
+  case STRING_LITERAL_NODE: {
+    StringLiteral* literal = (StringLiteral*)node;
+    if (!internLiterals) {
+      String* s = new String(literal->value);
+      gc.Add(s);
+      return s;
     }
-    return evalCallExpression(function, args, env);
-  } else if (type == "IndexExpression") {
-    Object* array = Eval(((IndexExpression*)node)->array, env);
+    if (literal->constant == nullptr)
+      literal->constant = intern(literal->value);
+    return literal->constant;
+  }
+  case IDENTIFIER_NODE:
+    return evalIdentifier((Identifier*)node, env);
+  case FUNCTION_LITERAL_NODE:
+    return newClosure((FunctionLiteral*)node, env);
+  case CALL_EXPRESSION_NODE:
+    return evalCall((CallExpression*)node, env, false);
+  case INDEX_EXPRESSION_NODE: {
+    Value array = Eval(((IndexExpression*)node)->array, env);
     if(isError(array)) {
       return array;
     }
-    env->Set(std::to_string((intptr_t)array), array);
-    Object* index = Eval(((IndexExpression*)node)->index, env);
-    env->store.erase(std::to_string((intptr_t)array));
+    roots.push_back(array);
+    Value index = Eval(((IndexExpression*)node)->index, env);
+    roots.pop_back();
     if(isError(index)) {
       return index;
     }
     return evalIndexExpression(array, index, env);
-  } else if (type == "ArrayLiteral") {
-    std::vector<Object*> elems;
-    for(auto* element : ((ArrayLiteral*)node)->elements) {  // for convenience, using pass by value
-      Object* elem = Eval(element, env);
-      if(isError(elem))
-      return elem;
-      elems.push_back(elem);
+  }
+  case ARRAY_LITERAL_NODE: {
+    size_t base = roots.size();
+    for(auto* element : ((ArrayLiteral*)node)->elements) {
+      Value elem = Eval(element, env);
+      if(isError(elem)) {
+        roots.resize(base);
+        return elem;
+      }
+      roots.push_back(unpin(elem));
     }
-    return new Array(elems);
-  } else if (type == "PrefixExpression") {
-    Object* right = Eval(((PrefixExpression*)node)->right, env);
+    std::vector<Value> elems(roots.begin() + base, roots.end());
+    roots.resize(base);
+    Array* a = new Array(elems);
+    gc.Add(a);
+    return a;
+  }
+  case HASH_LITERAL_NODE:
+    return evalHashLiteral((HashLiteral*)node, env);
+  case PREFIX_EXPRESSION_NODE: {
+    Value right = Eval(((PrefixExpression*)node)->right, env);
     if (isError(right))
       return right;
     return evalPrefixExpression(((PrefixExpression*)node)->op, right);
-  } else if (type == "InfixExpression") {
-    Object* left = Eval(((InfixExpression*)node)->left, env);
+  }
+  case INFIX_EXPRESSION_NODE: {
+    Value left = Eval(((InfixExpression*)node)->left, env);
     if (isError(left))
       return left;
-    // save tmp data
-    // TODO: find a better way
-    env->Set(std::to_string((intptr_t)left), left);
-    Object* right = Eval(((InfixExpression*)node)->right, env);
-    env->store.erase(std::to_string((intptr_t)left));
+    roots.push_back(left);
+    Value right = Eval(((InfixExpression*)node)->right, env);
+    roots.pop_back();
     if (isError(right))
       return right;
     return evalInfixExpression(((InfixExpression*)node)->op, left, right);
-  } else if (type == "IfExpression") {
-    Object* condition = Eval(((IfExpression*)node)->condition, env);
+  }
+  case IF_EXPRESSION_NODE: {
+    Value condition = Eval(((IfExpression*)node)->condition, env);
     if(isError(condition))
       return condition;
     if(isTruthy(condition)) {
@@ -332,37 +562,47 @@ Object* Evaluator::Eval(Node* node, Environment* env) {
     } else {
       return __NULL;
     }
-  } else if (type == "WhileExpression") {
+  }
+  case WHILE_EXPRESSION_NODE:
     while (true) {
-      Object* condition = Eval(((WhileExpression*)node)->condition, env);
+      Value condition = Eval(((WhileExpression*)node)->condition, env);
       if(isError(condition))
       return condition;
       if(!isTruthy(condition))
       return __NULL;
-      Object* result = Eval(((WhileExpression*)node)->consequence, env);
-      if (result->Type() == ERROR_OBJ || result->Type() == RETURN_VALUE_OBJ)
+      Value result = Eval(((WhileExpression*)node)->consequence, env);
+      if (result.Is(ERROR_OBJ) || result.Is(RETURN_VALUE_OBJ))
       return result;
     }
-  } else if (type == "ExpressionStatement") {
+  case EXPRESSION_STATEMENT_NODE:
     return Eval(((ExpressionStatement*)node)->expression, env);
-  } else if (type == "BlockStatement") {
+  case BLOCK_STATEMENT_NODE:
     return evalStatements(((BlockStatement*)node)->statements, env);
-  } else if (type == "ReturnStatement") {
-    Object* val = Eval(((ReturnStatement*)node)->returnValue, env);
-    if(isError(val))
+  case RETURN_STATEMENT_NODE: {
+    Expression* returnValue = ((ReturnStatement*)node)->returnValue;
+    Value val = returnValue->Kind() == CALL_EXPRESSION_NODE && !closures.empty() ?
+        evalCall((CallExpression*)returnValue, env, true) : Eval(returnValue, env);
+    if(isError(val) || val == Value(&tailCall))
       return val;
-    return new ReturnValue(val);
-  } else if (type == "LetStatement") {
-    Object* val = Eval(((LetStatement*)node)->value, env);
+    ReturnValue* r = new ReturnValue(val);
+    gc.Add(r);
+    return r;
+  }
+  case LET_STATEMENT_NODE: {
+    Value val = Eval(((LetStatement*)node)->value, env);
     if(isError(val))
       return val;
-    return env->Set(((LetStatement*)node)->name.value, val);
-  } else if (type == "RefStatement") {
-    Object* val = Eval(((RefStatement*)node)->value, env);
+    return setVariable(&((LetStatement*)node)->name, unpin(val), env);
+  }
+  case REF_STATEMENT_NODE: {
+    if (!((RefStatement*)node)->indexes.empty())
+      return evalIndexAssignment((RefStatement*)node, env);
+    Value val = Eval(((RefStatement*)node)->value, env);
     if(isError(val))
       return val;
-    return env->RefSet(((LetStatement*)node)->name.value, val);
-  } else {
+    return refSetVariable(&((RefStatement*)node)->name, val, env);
+  }
+  default:
     return __NULL;
   }
 }
@@ -1,7 +1,183 @@
 #include "../header/object.h"
 
 namespace monkey {
-  Null* __NULL = new Null();
-  Boolean* __TRUE = new Boolean(true);
-  Boolean* __FALSE = new Boolean(false);
-}
\ No newline at end of file
+
+/*
+ * Array
+ */
+// a buffer of its own before a change, the other arrays keep theirs.
+// values past the end were left by pop or belong to a longer array
+// that shared the buffer, they are dropped before the buffer grows.
+void Array::own() {
+  if (buffer->refs > 1) {
+    ArrayBuffer* copy = new ArrayBuffer();
+    copy->values.assign(begin(), end());
+    buffer->Release();
+    buffer = copy;
+    start = 0;
+  } else if (!atEnd()) {
+    buffer->values.resize(start + length);
+  }
+}
+
+Value Array::Set(size_t i, Value val) {
+  if (buffer->refs > 1)
+    own();
+  Value old = buffer->values[start + i];
+  buffer->values[start + i] = val;
+  return old;
+}
+
+void Array::Push(Value val) {
+  own();
+  buffer->values.push_back(val);
+  length++;
+}
+
+// a shorter range of the same buffer, nothing is copied
+Value Array::Pop() {
+  if (length == 0)
+    return __NULL;
+  length--;
+  return buffer->values[start + length];
+}
+
+// the range of this array reaches the end of the buffer, so the other
+// elements can go right after it, where no other array looks: the old
+// arrays still see their own ranges and the new one the longer range.
+// this makes let a = concat(a, [x]) in a loop linear.
+Array* Array::Concat(Array* other) {
+  if (other->length == 0)
+    return new Array(this, 0, length);
+  if (length == 0)
+    return new Array(other, 0, other->length);
+  if (buffer->refs == 1 || atEnd()) {
+    if (!atEnd())
+      buffer->values.resize(start + length);
+    // other may share the buffer, its elements can move when it grows
+    std::vector<Value> tail(other->begin(), other->end());
+    buffer->values.insert(buffer->values.end(), tail.begin(), tail.end());
+    return new Array(this, 0, length + tail.size());
+  }
+  std::vector<Value> values(begin(), end());
+  values.insert(values.end(), other->begin(), other->end());
+  return new Array(values);
+}
+
+/*
+ * Hash
+ */
+// fnv-1a for strings, the finalizer of murmur3 for integers,
+// both spread the key over the low bits the table uses
+uint32_t Hash::hashOf(Value key) {
+  if (key.IsInteger()) {
+    uint32_t h = (uint32_t)key.AsInteger();
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+  }
+  uint32_t h = 2166136261u;
+  for (char ch : ((String*)key.AsObject())->value) {
+    h ^= (uint8_t)ch;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static bool sameKey(Value a, Value b) {
+  if (a == b)
+    return true;
+  return a.Is(STRING_OBJ) && b.Is(STRING_OBJ) &&
+      ((String*)a.AsObject())->value == ((String*)b.AsObject())->value;
+}
+
+long Hash::find(Value key, uint32_t hash) {
+  if (slots.empty())
+    return -1;
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+    Slot& slot = slots[i];
+    if (slot.index == EMPTY)
+      return -1;
+    if (slot.index != DELETED && slot.hash == hash && sameKey(pairs[slot.index].key, key))
+      return i;
+  }
+}
+
+// drops the deleted pairs and makes the table at least twice as big as
+// the pairs left, the cached hashes give every pair its slot again
+void Hash::rehash() {
+  size_t kept = 0;
+  for (auto& pair : pairs) {
+    if (!pair.key.IsUnbound())
+      pairs[kept++] = pair;
+  }
+  pairs.resize(kept);
+  size_t capacity = 8;
+  while (capacity < (count + 1) * 2)
+    capacity *= 2;
+  slots.assign(capacity, Slot{0, EMPTY});
+  size_t mask = capacity - 1;
+  for (size_t index = 0; index < pairs.size(); index++) {
+    size_t i = pairs[index].hash & mask;
+    while (slots[i].index != EMPTY)
+      i = (i + 1) & mask;
+    slots[i] = Slot{pairs[index].hash, (int32_t)index};
+  }
+}
+
+Value Hash::Get(Value key) {
+  long i = find(key, hashOf(key));
+  return i < 0 ? Value::Unbound() : pairs[slots[i].index].value;
+}
+
+// the slots in use and the tombstones together are never more than the
+// pairs, so keeping the pairs below three quarters of the table leaves
+// an empty slot for every probe to stop at
+Value Hash::Set(Value key, Value value) {
+  uint32_t hash = hashOf(key);
+  long i = find(key, hash);
+  if (i >= 0) {
+    Value old = pairs[slots[i].index].value;
+    pairs[slots[i].index].value = value;
+    return old;
+  }
+  if ((pairs.size() + 1) * 4 > slots.size() * 3)
+    rehash();
+  size_t mask = slots.size() - 1;
+  i = hash & mask;
+  while (slots[i].index >= 0)
+    i = (i + 1) & mask;
+  slots[i] = Slot{hash, (int32_t)pairs.size()};
+  pairs.push_back(Pair{key, value, hash});
+  count++;
+  return Value::Unbound();
+}
+
+Value Hash::Delete(Value key) {
+  long i = find(key, hashOf(key));
+  if (i < 0)
+    return Value::Unbound();
+  Pair& pair = pairs[slots[i].index];
+  Value value = pair.value;
+  pair.key = Value::Unbound();
+  pair.value = __NULL;
+  slots[i].index = DELETED;
+  count--;
+  return value;
+}
+
+std::string Hash::Inspect() {
+  std::string res = "{";
+  for (auto& pair : pairs) {
+    if (!pair.key.IsUnbound())
+      res += pair.key.Inspect() + ": " + pair.value.Inspect() + ", ";
+  }
+  res += "}";
+  return res;
+}
+
+}  // namespace monkey
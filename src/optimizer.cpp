@@ -0,0 +1,244 @@
+#include <climits>
+#include "../header/optimizer.h"
+
+namespace monkey {
+
+/*
+ * utility functions
+ */
+bool isConstant(Expression* exp) {
+  if (exp == nullptr)
+    return false;
+  switch (exp->Kind()) {
+  case INTEGER_LITERAL_NODE:
+  case BOOLEAN_LITERAL_NODE:
+  case STRING_LITERAL_NODE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// isTruthy for a constant, strings are always truthy
+bool isTruthyConstant(Expression* exp) {
+  if (exp->Kind() == INTEGER_LITERAL_NODE)
+    return ((IntegerLiteral*)exp)->value != 0;
+  if (exp->Kind() == BOOLEAN_LITERAL_NODE)
+    return ((BooleanLiteral*)exp)->value;
+  return true;
+}
+
+// the if of a statement like if (true) { ... }, after foldIf
+IfExpression* constantIf(Statement* stmt) {
+  if (stmt->Kind() != EXPRESSION_STATEMENT_NODE)
+    return nullptr;
+  Expression* exp = ((ExpressionStatement*)stmt)->expression;
+  if (exp == nullptr || exp->Kind() != IF_EXPRESSION_NODE ||
+      !isConstant(((IfExpression*)exp)->condition))
+    return nullptr;
+  return (IfExpression*)exp;
+}
+
+/*
+ * new literals
+ */
+// nullptr if the value does not fit, the evaluator overflows there
+Expression* Optimizer::newInteger(const Token& token, long long value) {
+  if (value < INT_MIN || value > INT_MAX)
+    return nullptr;
+  IntegerLiteral* num = arena->New<IntegerLiteral>();
+  num->token = token;
+  num->value = value;
+  return num;
+}
+
+Expression* Optimizer::newBoolean(const Token& token, bool value) {
+  BooleanLiteral* b = arena->New<BooleanLiteral>();
+  b->token = token;
+  b->value = value;
+  return b;
+}
+
+Expression* Optimizer::newString(const Token& token, const std::string& value) {
+  StringLiteral* s = arena->New<StringLiteral>();
+  s->token = token;
+  s->value = value;
+  return s;
+}
+
+/*
+ * folding
+ * the same operators as Evaluator::evalPrefixExpression and
+ * Evaluator::evalInfixExpression, for the operands they accept.
+ */
+Expression* Optimizer::foldPrefix(PrefixExpression* prefix) {
+  prefix->right = optimize(prefix->right);
+  Expression* right = prefix->right;
+  if (!isConstant(right))
+    return prefix;
+  if (prefix->op == "!")
+    return newBoolean(prefix->token, !isTruthyConstant(right) && right->Kind() != STRING_LITERAL_NODE);
+  if (prefix->op == "-" && right->Kind() == INTEGER_LITERAL_NODE) {
+    Expression* folded = newInteger(prefix->token, -(long long)((IntegerLiteral*)right)->value);
+    return folded != nullptr ? folded : prefix;
+  }
+  return prefix;
+}
+
+Expression* Optimizer::foldInfix(InfixExpression* infix) {
+  infix->left = optimize(infix->left);
+  infix->right = optimize(infix->right);
+  Expression* left = infix->left;
+  Expression* right = infix->right;
+  if (!isConstant(left) || !isConstant(right) || left->Kind() != right->Kind())
+    return infix;
+  const std::string& op = infix->op;
+  const Token& token = infix->token;
+  Expression* folded = nullptr;
+  if (left->Kind() == INTEGER_LITERAL_NODE) {
+    long long l = ((IntegerLiteral*)left)->value;
+    long long r = ((IntegerLiteral*)right)->value;
+    if (op == "+") folded = newInteger(token, l + r);
+    else if (op == "-") folded = newInteger(token, l - r);
+    else if (op == "*") folded = newInteger(token, l * r);
+    else if (op == "/" && r != 0) folded = newInteger(token, l / r);
+    else if (op == "%" && r != 0) folded = newInteger(token, l % r);
+    else if (op == "==") folded = newBoolean(token, l == r);
+    else if (op == "!=") folded = newBoolean(token, l != r);
+    else if (op == ">") folded = newBoolean(token, l > r);
+    else if (op == "<") folded = newBoolean(token, l < r);
+    else if (op == ">=") folded = newBoolean(token, l >= r);
+    else if (op == "<=") folded = newBoolean(token, l <= r);
+  } else if (left->Kind() == STRING_LITERAL_NODE) {
+    if (op == "+")
+      folded = newString(token, ((StringLiteral*)left)->value + ((StringLiteral*)right)->value);
+  } else {
+    bool l = ((BooleanLiteral*)left)->value;
+    bool r = ((BooleanLiteral*)right)->value;
+    if (op == "==") folded = newBoolean(token, l == r);
+    else if (op == "!=") folded = newBoolean(token, l != r);
+  }
+  return folded != nullptr ? folded : infix;
+}
+
+// with a constant condition only the consequence is left: the live arm,
+// or an empty block when no arm runs.
+Expression* Optimizer::foldIf(IfExpression* ifExp) {
+  ifExp->condition = optimize(ifExp->condition);
+  optimizeStatement(ifExp->consequence);
+  if (ifExp->alternative != nullptr)
+    optimizeStatement(ifExp->alternative);
+  if (!isConstant(ifExp->condition))
+    return ifExp;
+  if (!isTruthyConstant(ifExp->condition)) {
+    if (ifExp->alternative != nullptr) {
+      ifExp->condition = newBoolean(ifExp->token, true);
+      ifExp->consequence = ifExp->alternative;
+    } else {
+      BlockStatement* empty = arena->New<BlockStatement>();
+      empty->token = ifExp->consequence->token;
+      ifExp->consequence = empty;
+    }
+  }
+  ifExp->alternative = nullptr;
+  return ifExp;
+}
+
+Expression* Optimizer::optimize(Expression* exp) {
+  if (exp == nullptr)
+    return nullptr;
+  switch (exp->Kind()) {
+  case PREFIX_EXPRESSION_NODE:
+    return foldPrefix((PrefixExpression*)exp);
+  case INFIX_EXPRESSION_NODE:
+    return foldInfix((InfixExpression*)exp);
+  case IF_EXPRESSION_NODE:
+    return foldIf((IfExpression*)exp);
+  case WHILE_EXPRESSION_NODE:
+    ((WhileExpression*)exp)->condition = optimize(((WhileExpression*)exp)->condition);
+    optimizeStatement(((WhileExpression*)exp)->consequence);
+    break;
+  case ARRAY_LITERAL_NODE:
+    for (auto& elem : ((ArrayLiteral*)exp)->elements)
+      elem = optimize(elem);
+    break;
+  case HASH_LITERAL_NODE:
+    for (auto& pair : ((HashLiteral*)exp)->pairs) {
+      pair.first = optimize(pair.first);
+      pair.second = optimize(pair.second);
+    }
+    break;
+  case INDEX_EXPRESSION_NODE:
+    ((IndexExpression*)exp)->array = optimize(((IndexExpression*)exp)->array);
+    ((IndexExpression*)exp)->index = optimize(((IndexExpression*)exp)->index);
+    break;
+  case CALL_EXPRESSION_NODE:
+    ((CallExpression*)exp)->function = optimize(((CallExpression*)exp)->function);
+    for (auto& arg : ((CallExpression*)exp)->arguments)
+      arg = optimize(arg);
+    break;
+  case FUNCTION_LITERAL_NODE:
+    optimizeStatement(((FunctionLiteral*)exp)->body);
+    break;
+  default:  // literals and identifiers
+    break;
+  }
+  return exp;
+}
+
+void Optimizer::optimizeStatement(Statement* stmt) {
+  if (stmt == nullptr)
+    return;
+  switch (stmt->Kind()) {
+  case LET_STATEMENT_NODE:
+    ((LetStatement*)stmt)->value = optimize(((LetStatement*)stmt)->value);
+    break;
+  case REF_STATEMENT_NODE:
+    for (auto& index : ((RefStatement*)stmt)->indexes)
+      index = optimize(index);
+    ((RefStatement*)stmt)->value = optimize(((RefStatement*)stmt)->value);
+    break;
+  case RETURN_STATEMENT_NODE:
+    ((ReturnStatement*)stmt)->returnValue = optimize(((ReturnStatement*)stmt)->returnValue);
+    break;
+  case EXPRESSION_STATEMENT_NODE:
+    ((ExpressionStatement*)stmt)->expression = optimize(((ExpressionStatement*)stmt)->expression);
+    break;
+  case BLOCK_STATEMENT_NODE:
+    optimizeStatements(((BlockStatement*)stmt)->statements);
+    break;
+  default:
+    break;
+  }
+}
+
+// blocks do not open a scope, so the live arm of a constant if can take
+// the place of the if. not when it is empty and the if is the last
+// statement, then the if still gives the value of the list.
+// nothing after a return can run.
+void Optimizer::optimizeStatements(std::vector<Statement*>& statements) {
+  std::vector<Statement*> result;
+  for (size_t i = 0; i < statements.size(); i++) {
+    Statement* stmt = statements[i];
+    optimizeStatement(stmt);
+    IfExpression* ifExp = constantIf(stmt);
+    std::vector<Statement*> live(1, stmt);
+    if (ifExp != nullptr && (!ifExp->consequence->statements.empty() || i + 1 < statements.size()))
+      live = ifExp->consequence->statements;
+    for (auto s : live) {
+      result.push_back(s);
+      if (s->Kind() == RETURN_STATEMENT_NODE) {
+        statements = result;
+        return;
+      }
+    }
+  }
+  statements = result;
+}
+
+void Optimizer::Optimize(Program* program) {
+  arena = program->arena;
+  optimizeStatements(program->statements);
+}
+
+}  // namespace monkey
@@ -2,21 +2,84 @@
 #include <stdexcept>
 
 namespace monkey {
-std::unordered_map<TokenType, Precedence> precedences({
-  {EQ,   EQUALS},
-  {NE,   EQUALS},
-  {LT,   LESSGREATER},
-  {GT,   LESSGREATER},
-  {LE,   LESSGREATER},
-  {GE,   LESSGREATER},
-  {PLUS,   SUM},
-  {MINUS,  SUM},
-  {SLASH,  PRODUCT},
-  {ASTERISK, PRODUCT},
-  {PERCENT,  PRODUCT},
-  {LPAREN,   CALL},
-  {LBRACKET, INDEX},
-});
+// indexed by TokenType, nullptr where a token cannot start or continue an expression
+const PrefixParseFn Parser::prefixParseFns[TOKEN_TYPE_COUNT] = {
+  nullptr,                          // ILLEGAL
+  nullptr,                          // END
+  &Parser::parseIdentifier,         // IDENT
+  &Parser::parseIntegerLiteral,     // INT
+  &Parser::parseStringLiteral,      // STRING
+  nullptr,                          // ASSIGN
+  nullptr,                          // PLUS
+  &Parser::parsePrefixExpression,   // MINUS
+  &Parser::parsePrefixExpression,   // BANG
+  nullptr,                          // ASTERISK
+  nullptr,                          // SLASH
+  nullptr,                          // PERCENT
+  nullptr,                          // LT
+  nullptr,                          // GT
+  nullptr,                          // LE
+  nullptr,                          // GE
+  nullptr,                          // EQ
+  nullptr,                          // NE
+  nullptr,                          // COMMA
+  nullptr,                          // SEMICOLON
+  nullptr,                          // COLON
+  &Parser::parseGroupedExpression,  // LPAREN
+  nullptr,                          // RPAREN
+  &Parser::parseHashLiteral,        // LBRACE
+  nullptr,                          // RBRACE
+  &Parser::parseArrayLiteral,       // LBRACKET
+  nullptr,                          // RBRACKET
+  nullptr,                          // REF
+  &Parser::parseFunctionLiteral,    // FUNCTION
+  nullptr,                          // LET
+  &Parser::parseBoolean,            // TRUE
+  &Parser::parseBoolean,            // FALSE
+  &Parser::parseIfExpression,       // IF
+  nullptr,                          // ELSE
+  nullptr,                          // RETURN
+  &Parser::parseWhileExpression,    // WHILE
+};
+
+const InfixParseFn Parser::infixParseFns[TOKEN_TYPE_COUNT] = {
+  nullptr,                          // ILLEGAL
+  nullptr,                          // END
+  nullptr,                          // IDENT
+  nullptr,                          // INT
+  nullptr,                          // STRING
+  nullptr,                          // ASSIGN
+  &Parser::parseInfixExpression,    // PLUS
+  &Parser::parseInfixExpression,    // MINUS
+  nullptr,                          // BANG
+  &Parser::parseInfixExpression,    // ASTERISK
+  &Parser::parseInfixExpression,    // SLASH
+  &Parser::parseInfixExpression,    // PERCENT
+  &Parser::parseInfixExpression,    // LT
+  &Parser::parseInfixExpression,    // GT
+  &Parser::parseInfixExpression,    // LE
+  &Parser::parseInfixExpression,    // GE
+  &Parser::parseInfixExpression,    // EQ
+  &Parser::parseInfixExpression,    // NE
+  nullptr,                          // COMMA
+  nullptr,                          // SEMICOLON
+  nullptr,                          // COLON
+  &Parser::parseCallExpression,     // LPAREN
+  nullptr,                          // RPAREN
+  nullptr,                          // LBRACE
+  nullptr,                          // RBRACE
+  &Parser::parseIndexExpression,    // LBRACKET
+  nullptr,                          // RBRACKET
+  nullptr,                          // REF
+  nullptr,                          // FUNCTION
+  nullptr,                          // LET
+  nullptr,                          // TRUE
+  nullptr,                          // FALSE
+  nullptr,                          // IF
+  nullptr,                          // ELSE
+  nullptr,                          // RETURN
+  nullptr,                          // WHILE
+};
 
 void Parser::nextToken() {
   curToken = peekToken;
@@ -34,19 +97,15 @@ bool Parser::expectPeek(const TokenType& t) {
 }
 
 Precedence Parser::peekPrecedence() {
-  if(precedences.find(peekToken.type) != precedences.end())
-    return precedences[peekToken.type];
-  return LOWEST;
+  return precedences[peekToken.type];
 }
 
 Precedence Parser::curPrecedence() {
-  if(precedences.find(curToken.type) != precedences.end())
-    return precedences[curToken.type];
-  return LOWEST;
+  return precedences[curToken.type];
 }
 
 void Parser::peekError(const TokenType& t) {
-  errors.push_back("expect to be " + t + ", got " + peekToken.type);
+  errors.push_back("expect to be " + TokenTypeString(t) + ", got " + TokenTypeString(peekToken.type));
 }
 
 Statement* Parser::parseStatement() {
@@ -62,17 +121,15 @@ Statement* Parser::parseStatement() {
 }
 
 LetStatement* Parser::parseLetStatement() {
-  LetStatement* stmt = new LetStatement();
+  LetStatement* stmt = arena->New<LetStatement>();
   stmt->token = curToken;
 
   if(!expectPeek(IDENT)) {
-    delete stmt;
     return nullptr;
   }
   stmt->name.token = curToken;
   stmt->name.value = curToken.literal;
   if(!expectPeek(ASSIGN)) {
-    delete stmt;
     return nullptr;
   }
   nextToken();
@@ -85,17 +142,23 @@ LetStatement* Parser::parseLetStatement() {
 }
 
 RefStatement* Parser::parseRefStatement() {
-  RefStatement* stmt = new RefStatement();
+  RefStatement* stmt = arena->New<RefStatement>();
   stmt->token = curToken;
 
   if(!expectPeek(IDENT)) {
-    delete stmt;
     return nullptr;
   }
   stmt->name.token = curToken;
   stmt->name.value = curToken.literal;
+  while(peekToken.type == LBRACKET) {
+    nextToken();
+    nextToken();
+    stmt->indexes.push_back(parseExpression(LOWEST));
+    if(!expectPeek(RBRACKET)) {
+      return nullptr;
+    }
+  }
   if(!expectPeek(ASSIGN)) {
-    delete stmt;
     return nullptr;
   }
   nextToken();
@@ -108,7 +171,7 @@ RefStatement* Parser::parseRefStatement() {
 }
 
 ReturnStatement* Parser::parseReturnStatement() {
-  ReturnStatement* stmt = new ReturnStatement();
+  ReturnStatement* stmt = arena->New<ReturnStatement>();
   stmt->token = curToken;
 
   nextToken();
@@ -121,7 +184,7 @@ ReturnStatement* Parser::parseReturnStatement() {
 }
 
 ExpressionStatement* Parser::parseExpressionStatement() {
-  ExpressionStatement* stmt = new ExpressionStatement();
+  ExpressionStatement* stmt = arena->New<ExpressionStatement>();
   stmt->token = curToken;
   stmt->expression = parseExpression(LOWEST);
 
@@ -131,7 +194,7 @@ ExpressionStatement* Parser::parseExpressionStatement() {
 }
 
 BlockStatement* Parser::parseBlockStatement() {
-  BlockStatement* block = new BlockStatement();
+  BlockStatement* block = arena->New<BlockStatement>();
   block->token = curToken;
   
   nextToken();
@@ -147,19 +210,19 @@ BlockStatement* Parser::parseBlockStatement() {
 }
 
 Expression* Parser::parseExpression(Precedence precedence) {
-  if (prefixParseFns.find(curToken.type) == prefixParseFns.end()) {
+  PrefixParseFn prefix = prefixParseFns[curToken.type];
+  if (prefix == nullptr) {
     noPrefixParseFnError(curToken.type);
     return nullptr;
   }
-  PrefixParseFn prefix = prefixParseFns[curToken.type];
 
   Expression* leftExp = (this->*prefix)(); // notice this is the correct way to call a method pointer
   
   while(peekToken.type != SEMICOLON && precedence < peekPrecedence()) {
-    if (infixParseFns.find(peekToken.type) == infixParseFns.end()) {
+    InfixParseFn infix = infixParseFns[peekToken.type];
+    if (infix == nullptr) {
     return leftExp;
     }
-    InfixParseFn infix = infixParseFns[peekToken.type]; 
 
     nextToken();
 
@@ -185,36 +248,36 @@ std::vector<Expression*> Parser::parseExpressionList() {
 }
 
 Expression* Parser::parseIdentifier() {
-  Identifier* ident = new Identifier();
+  Identifier* ident = arena->New<Identifier>();
   ident->token = curToken;
   ident->value = curToken.literal;
   return ident;
 }
 
 Expression* Parser::parseBoolean() {
-  BooleanLiteral* ident = new BooleanLiteral();
+  BooleanLiteral* ident = arena->New<BooleanLiteral>();
   ident->token = curToken;
   ident->value = curToken.type == TRUE;
   return ident;
 }
 
 Expression* Parser::parseIntegerLiteral() {
-  IntegerLiteral* num = new IntegerLiteral();
+  IntegerLiteral* num = arena->New<IntegerLiteral>();
   num->token = curToken;
   try {
     num->value = std::stoi(curToken.literal);
   } catch (const std::invalid_argument e) {  // C++ does not have a base class for exception
-    errors.push_back("cannot parse the " + curToken.literal + " to int");
+    errors.push_back("cannot parse the " + curToken.literal.String() + " to int");
     return nullptr;
   } catch (const std::out_of_range e) {  // this is suggested as best practice
-    errors.push_back("the integer " + curToken.literal + " is out of range");
+    errors.push_back("the integer " + curToken.literal.String() + " is out of range");
     return nullptr;
   }
   return num;
 }
 
 Expression* Parser::parseStringLiteral() {
-  StringLiteral* s = new StringLiteral();
+  StringLiteral* s = arena->New<StringLiteral>();
   s->token = curToken;
   s->value = curToken.literal;
   return s;
@@ -230,7 +293,7 @@ std::vector<Identifier*> Parser::parseFunctionParameters() {
 
   nextToken(); // pass "," or "("
 
-  Identifier* ident = new Identifier();
+  Identifier* ident = arena->New<Identifier>();
   ident->token = curToken;
   ident->value = curToken.literal;
   parameters.push_back(ident);
@@ -238,7 +301,7 @@ std::vector<Identifier*> Parser::parseFunctionParameters() {
   while(peekToken.type == COMMA) {
     nextToken();
     nextToken();
-    Identifier* ident = new Identifier();
+    Identifier* ident = arena->New<Identifier>();
     ident->token = curToken;
     ident->value = curToken.literal;
     parameters.push_back(ident);
@@ -251,18 +314,17 @@ std::vector<Identifier*> Parser::parseFunctionParameters() {
 }
 
 Expression* Parser::parseFunctionLiteral() {
-  FunctionLiteral* fn = new FunctionLiteral();
+  FunctionLiteral* fn = arena->New<FunctionLiteral>();
   fn->token = curToken;
+  fn->arena = arena;
 
   if(!expectPeek(LPAREN)) { // in this function, only deal with "("
-    delete fn;
     return nullptr;
   }
 
   fn->parameters = parseFunctionParameters();
 
   if(!expectPeek(LBRACE)) {
-    delete fn;
     return nullptr;
   }
 
@@ -271,7 +333,7 @@ Expression* Parser::parseFunctionLiteral() {
 }
 
 Expression* Parser::parseArrayLiteral() {
-  ArrayLiteral* exp = new ArrayLiteral();
+  ArrayLiteral* exp = arena->New<ArrayLiteral>();
   exp->token = curToken;
   if(peekToken.type == RBRACKET) {
     nextToken();
@@ -283,8 +345,27 @@ Expression* Parser::parseArrayLiteral() {
   return exp;
 }
 
+// {key: value, ...}, the pairs in the order they are written
+Expression* Parser::parseHashLiteral() {
+  HashLiteral* exp = arena->New<HashLiteral>();
+  exp->token = curToken;
+  while(peekToken.type != RBRACE) {
+    nextToken();
+    Expression* key = parseExpression(LOWEST);
+    if(!expectPeek(COLON))
+      return nullptr;
+    nextToken();
+    Expression* value = parseExpression(LOWEST);
+    exp->pairs.push_back(std::make_pair(key, value));
+    if(peekToken.type != RBRACE && !expectPeek(COMMA))
+      return nullptr;
+  }
+  nextToken();  // pass "}"
+  return exp;
+}
+
 Expression* Parser::parsePrefixExpression() {
-  PrefixExpression* exp = new PrefixExpression();
+  PrefixExpression* exp = arena->New<PrefixExpression>();
   exp->token = curToken;
   exp->op = curToken.literal;
 
@@ -300,7 +381,6 @@ Expression* Parser::parseGroupedExpression() {
   Expression* exp = parseExpression(LOWEST);
 
   if(!expectPeek(RPAREN)) {
-    delete exp;
     return nullptr;
   }
 
@@ -308,24 +388,21 @@ Expression* Parser::parseGroupedExpression() {
 }
 
 Expression* Parser::parseIfExpression() {
-  IfExpression* exp = new IfExpression();
+  IfExpression* exp = arena->New<IfExpression>();
   exp->token = curToken;
   
   // condition
   if(!expectPeek(LPAREN)) {
-    delete exp;
     return nullptr;
   }
   nextToken();
   exp->condition = parseExpression(LOWEST);
   if(!expectPeek(RPAREN)) {
-    delete exp;
     return nullptr;
   }
   
   // consequence
   if(!expectPeek(LBRACE)) {
-    delete exp;
     return nullptr;
   }
   exp->consequence = parseBlockStatement();
@@ -334,7 +411,6 @@ Expression* Parser::parseIfExpression() {
   if (peekToken.type == ELSE) {
     nextToken();
     if (!expectPeek(LBRACE)) {
-    delete exp;
     return nullptr;
     }
     exp->alternative = parseBlockStatement();
@@ -343,24 +419,21 @@ Expression* Parser::parseIfExpression() {
 }
 
 Expression* Parser::parseWhileExpression() {
-  WhileExpression* exp = new WhileExpression();
+  WhileExpression* exp = arena->New<WhileExpression>();
   exp->token = curToken;
   
   // condition
   if(!expectPeek(LPAREN)) {
-    delete exp;
     return nullptr;
   }
   nextToken();
   exp->condition = parseExpression(LOWEST);
   if(!expectPeek(RPAREN)) {
-    delete exp;
     return nullptr;
   }
   
   // consequence
   if(!expectPeek(LBRACE)) {
-    delete exp;
     return nullptr;
   }
   exp->consequence = parseBlockStatement();
@@ -369,7 +442,7 @@ Expression* Parser::parseWhileExpression() {
 }
   
 Expression* Parser::parseCallExpression(Expression* function) {
-  CallExpression* exp = new CallExpression();
+  CallExpression* exp = arena->New<CallExpression>();
   exp->token = curToken;
   exp->function = function;
   if(peekToken.type == RPAREN) {
@@ -383,7 +456,7 @@ Expression* Parser::parseCallExpression(Expression* function) {
 }
 
 Expression* Parser::parseIndexExpression(Expression* array) {
-  IndexExpression* exp = new IndexExpression();
+  IndexExpression* exp = arena->New<IndexExpression>();
   exp->token = curToken;
   exp->array = array;
   nextToken();
@@ -395,7 +468,7 @@ Expression* Parser::parseIndexExpression(Expression* array) {
 }
 
 Expression* Parser::parseInfixExpression(Expression* left) {
-  InfixExpression* exp = new InfixExpression();
+  InfixExpression* exp = arena->New<InfixExpression>();
   exp->token = curToken;
   exp->op = curToken.literal;
   exp->left = left;
@@ -408,39 +481,13 @@ Expression* Parser::parseInfixExpression(Expression* left) {
 }
 
 void Parser::noPrefixParseFnError(TokenType type) {
-  errors.push_back("no prefix parse fucntion for " + type);
+  errors.push_back("no prefix parse fucntion for " + TokenTypeString(type));
 }
 
 void Parser::New(Lexer& l) {
   this->l = l;
+  errors.clear();
 
-  // prefix parse functions
-  prefixParseFns[IDENT]  = &Parser::parseIdentifier;  // this is how to assign a method pointer
-  prefixParseFns[INT]  = &Parser::parseIntegerLiteral;
-  prefixParseFns[STRING]   = &Parser::parseStringLiteral;
-  prefixParseFns[BANG]   = &Parser::parsePrefixExpression;
-  prefixParseFns[MINUS]  = &Parser::parsePrefixExpression;
-  prefixParseFns[TRUE]   = &Parser::parseBoolean;
-  prefixParseFns[FALSE]  = &Parser::parseBoolean;
-  prefixParseFns[LPAREN]   = &Parser::parseGroupedExpression;
-  prefixParseFns[IF]   = &Parser::parseIfExpression;
-  prefixParseFns[WHILE]  = &Parser::parseWhileExpression;
-  prefixParseFns[FUNCTION] = &Parser::parseFunctionLiteral;
-  prefixParseFns[LBRACKET] = &Parser::parseArrayLiteral;
-  // infix parse functions
-  infixParseFns[PLUS]   = &Parser::parseInfixExpression;
-  infixParseFns[MINUS]  = &Parser::parseInfixExpression;
-  infixParseFns[SLASH]  = &Parser::parseInfixExpression;
-  infixParseFns[ASTERISK] = &Parser::parseInfixExpression;
-  infixParseFns[PERCENT]  = &Parser::parseInfixExpression;
-  infixParseFns[EQ]   = &Parser::parseInfixExpression;
-  infixParseFns[NE]   = &Parser::parseInfixExpression;
-  infixParseFns[LT]   = &Parser::parseInfixExpression;
-  infixParseFns[GT]   = &Parser::parseInfixExpression;
-  infixParseFns[LE]   = &Parser::parseInfixExpression;
-  infixParseFns[GE]   = &Parser::parseInfixExpression;
-  infixParseFns[LPAREN]   = &Parser::parseCallExpression;
-  infixParseFns[LBRACKET] = &Parser::parseIndexExpression;
   // read two tokens, so that both curToken and peekToken are set.
   nextToken();
   nextToken();
@@ -448,6 +495,7 @@ void Parser::New(Lexer& l) {
 
 Program* Parser::ParseProgram() {
   Program *program = new Program();
+  arena = program->arena;
 
   while(curToken.type != END) {
     Statement* stmt = parseStatement();
@@ -459,4 +507,18 @@ Program* Parser::ParseProgram() {
   return program;
 }
 
-}  // namespace monkey
\ No newline at end of file
+// one top level statement in a Program of its own, nullptr at the end.
+// the caller stops at the first error, the statements before it have run.
+Program* Parser::ParseStatement() {
+  if (curToken.type == END)
+    return nullptr;
+  Program* program = new Program();
+  arena = program->arena;
+  Statement* stmt = parseStatement();
+  if (stmt != nullptr)
+    program->statements.push_back(stmt);
+  nextToken();
+  return program;
+}
+
+}  // namespace monkey
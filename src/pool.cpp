@@ -0,0 +1,48 @@
+#include "../header/pool.h"
+#include <new>
+
+namespace monkey {
+
+Pool::FreeNode* Pool::freeLists[MAX_POOLED_SIZE / POOL_GRANULE + 1];
+
+// build with -DMONKEY_NO_POOL to check memory errors with a sanitizer
+#ifdef MONKEY_NO_POOL
+const bool POOLED = false;
+#else
+const bool POOLED = true;
+#endif
+
+void* Pool::Allocate(size_t size) {
+  if (!POOLED || size > MAX_POOLED_SIZE)
+    return ::operator new(size);
+  size_t cls = (size + POOL_GRANULE - 1) / POOL_GRANULE;
+  if (freeLists[cls] == nullptr)
+    refill(cls);
+  FreeNode* node = freeLists[cls];
+  freeLists[cls] = node->next;
+  return node;
+}
+
+void Pool::Free(void* p, size_t size) {
+  if (!POOLED || size > MAX_POOLED_SIZE) {
+    ::operator delete(p);
+    return;
+  }
+  size_t cls = (size + POOL_GRANULE - 1) / POOL_GRANULE;
+  FreeNode* node = (FreeNode*)p;
+  node->next = freeLists[cls];
+  freeLists[cls] = node;
+}
+
+// cut a new slab into objects of the class, in address order
+void Pool::refill(size_t cls) {
+  size_t size = cls * POOL_GRANULE;
+  char* slab = (char*)::operator new(SLAB_SIZE);
+  for (size_t offset = SLAB_SIZE / size * size; offset >= size; offset -= size) {
+    FreeNode* node = (FreeNode*)(slab + offset - size);
+    node->next = freeLists[cls];
+    freeLists[cls] = node;
+  }
+}
+
+}  // namespace monkey
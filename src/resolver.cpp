@@ -0,0 +1,200 @@
+#include "../header/resolver.h"
+
+namespace monkey {
+
+// collect the names a scope defines, without entering nested functions
+void Resolver::declare(Node* node, Scope* scope) {
+  if (node == nullptr)
+    return;
+  switch (node->Kind()) {
+  case LET_STATEMENT_NODE:
+    scope->Define(((LetStatement*)node)->name.value);
+    declare(((LetStatement*)node)->value, scope);
+    break;
+  case REF_STATEMENT_NODE:
+    // &a[i] = v stores into the array a names, it does not define a
+    if (((RefStatement*)node)->indexes.empty())
+      scope->Define(((RefStatement*)node)->name.value);
+    for (auto index : ((RefStatement*)node)->indexes)
+      declare(index, scope);
+    declare(((RefStatement*)node)->value, scope);
+    break;
+  case RETURN_STATEMENT_NODE:
+    declare(((ReturnStatement*)node)->returnValue, scope);
+    break;
+  case EXPRESSION_STATEMENT_NODE:
+    declare(((ExpressionStatement*)node)->expression, scope);
+    break;
+  case BLOCK_STATEMENT_NODE:
+    for (auto stmt : ((BlockStatement*)node)->statements)
+      declare(stmt, scope);
+    break;
+  case PREFIX_EXPRESSION_NODE:
+    declare(((PrefixExpression*)node)->right, scope);
+    break;
+  case INFIX_EXPRESSION_NODE:
+    declare(((InfixExpression*)node)->left, scope);
+    declare(((InfixExpression*)node)->right, scope);
+    break;
+  case IF_EXPRESSION_NODE:
+    declare(((IfExpression*)node)->condition, scope);
+    declare(((IfExpression*)node)->consequence, scope);
+    declare(((IfExpression*)node)->alternative, scope);
+    break;
+  case WHILE_EXPRESSION_NODE:
+    declare(((WhileExpression*)node)->condition, scope);
+    declare(((WhileExpression*)node)->consequence, scope);
+    break;
+  case ARRAY_LITERAL_NODE:
+    for (auto elem : ((ArrayLiteral*)node)->elements)
+      declare(elem, scope);
+    break;
+  case HASH_LITERAL_NODE:
+    for (auto& pair : ((HashLiteral*)node)->pairs) {
+      declare(pair.first, scope);
+      declare(pair.second, scope);
+    }
+    break;
+  case INDEX_EXPRESSION_NODE:
+    declare(((IndexExpression*)node)->array, scope);
+    declare(((IndexExpression*)node)->index, scope);
+    break;
+  case CALL_EXPRESSION_NODE:
+    declare(((CallExpression*)node)->function, scope);
+    for (auto arg : ((CallExpression*)node)->arguments)
+      declare(arg, scope);
+    break;
+  default:  // literals, identifiers and functions define nothing here
+    break;
+  }
+}
+
+void Resolver::resolveIdentifier(Identifier* ident, Scope* scope) {
+  if (scope != &globals) {
+    ident->slot = scope->Find(ident->value);
+    if (ident->slot != -1) {
+      ident->kind = LOCAL_VARIABLE;
+      locals.push_back(ident);
+      return;
+    }
+    ident->slot = resolveUpvalue(scope, ident->value);
+    if (ident->slot != -1) {
+      ident->kind = UPVALUE_VARIABLE;
+      return;
+    }
+  }
+  ident->kind = GLOBAL_VARIABLE;
+  ident->slot = globals.Define(ident->value);
+}
+
+// the upvalue of scope for name, captured from the enclosing functions.
+// -1 if none of them defines it.
+int Resolver::resolveUpvalue(Scope* scope, const std::string& name) {
+  int index = scope->FindUpvalue(name);
+  if (index != -1 || scope->enclosing == nullptr)
+    return index;
+  int slot = scope->enclosing->Find(name);
+  if (slot != -1) {
+    scope->enclosing->AddCell(slot);
+    return scope->AddUpvalue(name, Capture{true, slot});
+  }
+  index = resolveUpvalue(scope->enclosing, name);
+  if (index == -1)
+    return -1;
+  return scope->AddUpvalue(name, Capture{false, index});
+}
+
+void Resolver::resolve(Node* node, Scope* scope) {
+  if (node == nullptr)
+    return;
+  switch (node->Kind()) {
+  case IDENTIFIER_NODE:
+    resolveIdentifier((Identifier*)node, scope);
+    break;
+  case LET_STATEMENT_NODE:
+    resolveIdentifier(&((LetStatement*)node)->name, scope);
+    resolve(((LetStatement*)node)->value, scope);
+    break;
+  case REF_STATEMENT_NODE:
+    resolveIdentifier(&((RefStatement*)node)->name, scope);
+    for (auto index : ((RefStatement*)node)->indexes)
+      resolve(index, scope);
+    resolve(((RefStatement*)node)->value, scope);
+    break;
+  case RETURN_STATEMENT_NODE:
+    resolve(((ReturnStatement*)node)->returnValue, scope);
+    break;
+  case EXPRESSION_STATEMENT_NODE:
+    resolve(((ExpressionStatement*)node)->expression, scope);
+    break;
+  case BLOCK_STATEMENT_NODE:
+    for (auto stmt : ((BlockStatement*)node)->statements)
+      resolve(stmt, scope);
+    break;
+  case PREFIX_EXPRESSION_NODE:
+    resolve(((PrefixExpression*)node)->right, scope);
+    break;
+  case INFIX_EXPRESSION_NODE:
+    resolve(((InfixExpression*)node)->left, scope);
+    resolve(((InfixExpression*)node)->right, scope);
+    break;
+  case IF_EXPRESSION_NODE:
+    resolve(((IfExpression*)node)->condition, scope);
+    resolve(((IfExpression*)node)->consequence, scope);
+    resolve(((IfExpression*)node)->alternative, scope);
+    break;
+  case WHILE_EXPRESSION_NODE:
+    resolve(((WhileExpression*)node)->condition, scope);
+    resolve(((WhileExpression*)node)->consequence, scope);
+    break;
+  case ARRAY_LITERAL_NODE:
+    for (auto elem : ((ArrayLiteral*)node)->elements)
+      resolve(elem, scope);
+    break;
+  case HASH_LITERAL_NODE:
+    for (auto& pair : ((HashLiteral*)node)->pairs) {
+      resolve(pair.first, scope);
+      resolve(pair.second, scope);
+    }
+    break;
+  case INDEX_EXPRESSION_NODE:
+    resolve(((IndexExpression*)node)->array, scope);
+    resolve(((IndexExpression*)node)->index, scope);
+    break;
+  case CALL_EXPRESSION_NODE:
+    resolve(((CallExpression*)node)->function, scope);
+    for (auto arg : ((CallExpression*)node)->arguments)
+      resolve(arg, scope);
+    break;
+  case FUNCTION_LITERAL_NODE: {
+    FunctionLiteral* fn = (FunctionLiteral*)node;
+    delete fn->scope;
+    fn->scope = new Scope();
+    fn->scope->enclosing = scope == &globals ? nullptr : scope;
+    for (auto param : fn->parameters)
+      fn->scope->Define(param->value);  // parameters take the first slots
+    declare(fn->body, fn->scope);
+    size_t base = locals.size();
+    for (auto param : fn->parameters)
+      resolveIdentifier(param, fn->scope);
+    resolve(fn->body, fn->scope);
+    for (size_t i = base; i < locals.size(); i++) {
+      if (fn->scope->IsCell(locals[i]->slot))
+        locals[i]->kind = CELL_VARIABLE;
+    }
+    locals.resize(base);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void Resolver::Resolve(Program* program) {
+  for (auto stmt : program->statements)
+    declare(stmt, &globals);
+  for (auto stmt : program->statements)
+    resolve(stmt, &globals);
+}
+
+}  // namespace monkey
@@ -1,22 +1,77 @@
+#include <cstring>
 #include "../header/token.h"
 
 namespace monkey {
 
-std::unordered_map<std::string, TokenType> keywords({
-  {"let", LET},
-  {"fn", FUNCTION},
-  {"true", TRUE},
-  {"false", FALSE},
-  {"if", IF},
-  {"else", ELSE},
-  {"return", RETURN},
-  {"while", WHILE}
-});
+std::string TokenTypeString(TokenType type) {
+  switch (type) {
+  case ILLEGAL: return "ILLEGAL";
+  case END: return "END";
+  case IDENT: return "IDENT";
+  case INT: return "INT";
+  case STRING: return "STRING";
+  case ASSIGN: return "=";
+  case PLUS: return "+";
+  case MINUS: return "-";
+  case BANG: return "!";
+  case ASTERISK: return "*";
+  case SLASH: return "/";
+  case PERCENT: return "%";
+  case LT: return "<";
+  case GT: return ">";
+  case LE: return "<=";
+  case GE: return ">=";
+  case EQ: return "==";
+  case NE: return "!=";
+  case COMMA: return ",";
+  case SEMICOLON: return ";";
+  case COLON: return ":";
+  case LPAREN: return "(";
+  case RPAREN: return ")";
+  case LBRACE: return "{";
+  case RBRACE: return "}";
+  case LBRACKET: return "[";
+  case RBRACKET: return "]";
+  case REF: return "&";
+  case FUNCTION: return "FUNCTION";
+  case LET: return "LET";
+  case TRUE: return "TRUE";
+  case FALSE: return "FALSE";
+  case IF: return "IF";
+  case ELSE: return "ELSE";
+  case RETURN: return "RETURN";
+  case WHILE: return "WHILE";
+  default: return "UNKNOWN";
+  }
+}
 
-TokenType LookupIdent(std::string ident) {
-  if(keywords.find(ident)== keywords.end())
-    return IDENT;
-  return keywords[ident];
+// keywords are told apart by their first letter and length
+TokenType LookupIdent(const char* ident, size_t length) {
+  switch (ident[0]) {
+  case 'e':
+    if (length == 4 && memcmp(ident, "else", 4) == 0) return ELSE;
+    break;
+  case 'f':
+    if (length == 2 && ident[1] == 'n') return FUNCTION;
+    if (length == 5 && memcmp(ident, "false", 5) == 0) return FALSE;
+    break;
+  case 'i':
+    if (length == 2 && ident[1] == 'f') return IF;
+    break;
+  case 'l':
+    if (length == 3 && memcmp(ident, "let", 3) == 0) return LET;
+    break;
+  case 'r':
+    if (length == 6 && memcmp(ident, "return", 6) == 0) return RETURN;
+    break;
+  case 't':
+    if (length == 4 && memcmp(ident, "true", 4) == 0) return TRUE;
+    break;
+  case 'w':
+    if (length == 5 && memcmp(ident, "while", 5) == 0) return WHILE;
+    break;
+  }
+  return IDENT;
 }
 
 }  // namespace monkey
@@ -0,0 +1,567 @@
+#include "../header/vm.h"
+#include "../header/builtin.h"
+
+namespace monkey {
+
+/*
+ * utility functions
+ */
+std::string operatorString(Opcode op) {
+  switch (op) {
+  case OP_ADD: return "+";
+  case OP_SUB: return "-";
+  case OP_MUL: return "*";
+  case OP_DIV: return "/";
+  case OP_MOD: return "%";
+  case OP_EQ: return "==";
+  case OP_NE: return "!=";
+  case OP_GT: return ">";
+  case OP_LT: return "<";
+  case OP_GE: return ">=";
+  case OP_LE: return "<=";
+  default: return "";
+  }
+}
+
+Object* VM::track(Object* obj) {
+  gc.Add(obj);
+  gc.Step([&]() { markRoots(obj); });
+  return obj;
+}
+
+// interned literals are shared, give the variable its own copy
+Value VM::unpin(Value val) {
+  if (!isPinned(val))
+    return val;
+  return track(new String(((String*)val.AsObject())->value));
+}
+
+// a String key is copied unless it is interned, so that a reference
+// assignment to the string cannot change the key inside the table
+Value VM::hashKey(Value key) {
+  if (!Hash::Hashable(key))
+    return new Error("unusable as hash key: " + key.Type());
+  if (!key.IsObject() || isPinned(key))
+    return key;
+  return track(new String(((String*)key.AsObject())->value));
+}
+
+// everything alive is either on the stack or in the environments.
+// the environment of a call is enclosed in the one of its caller, not in
+// the one the function was written in (see callFunction), so the innermost
+// frame reaches the environments of all the frames below it. scoping does
+// not use this chain, closures reach their variables through upvalues.
+void VM::markRoots(Object* extra) {
+  gc.Mark(extra);
+  for (int i = 0; i < sp; i++) {
+    gc.Mark(stack[i]);
+  }
+  gc.Mark(frames.back().env);
+  for (auto& frame : frames)
+    gc.Mark(Value(frame.fn));  // may be a copy that only the frame holds
+}
+
+// drop the frames of an aborted program
+Value VM::unwind(Value err) {
+  while (frames.size() > 1) {
+    frames.back().env->Release();
+    frames.pop_back();
+  }
+  frames.pop_back();
+  sp = 0;
+  return err;
+}
+
+/*
+ * operators
+ */
+Value VM::executeIntegerOperation(Opcode op, Value left, Value right) {
+  int leftVal = left.AsInteger();
+  int rightVal = right.AsInteger();
+  switch (op) {
+  case OP_ADD: return Value::FromInteger(leftVal + rightVal);
+  case OP_SUB: return Value::FromInteger(leftVal - rightVal);
+  case OP_MUL: return Value::FromInteger(leftVal * rightVal);
+  case OP_DIV:
+    if (rightVal != 0)
+      return Value::FromInteger(leftVal / rightVal);
+    break;
+  case OP_MOD:
+    if (rightVal != 0)
+      return Value::FromInteger(leftVal % rightVal);
+    break;
+  case OP_EQ: return leftVal == rightVal ? __TRUE : __FALSE;
+  case OP_NE: return leftVal != rightVal ? __TRUE : __FALSE;
+  case OP_GT: return leftVal > rightVal ? __TRUE : __FALSE;
+  case OP_LT: return leftVal < rightVal ? __TRUE : __FALSE;
+  case OP_GE: return leftVal >= rightVal ? __TRUE : __FALSE;
+  case OP_LE: return leftVal <= rightVal ? __TRUE : __FALSE;
+  }
+  return new Error("unknown operator: " + left.Type() + " " + operatorString(op) + " " + right.Type());
+}
+
+Value VM::executeStringOperation(Opcode op, Value left, Value right) {
+  if (op != OP_ADD)
+    return new Error("unknown operator: " + left.Type() + " " + operatorString(op) + " " + right.Type());
+  return track(new String(((String*)left.AsObject())->value + ((String*)right.AsObject())->value));
+}
+
+Value VM::executeBinaryOperation(Opcode op, Value left, Value right) {
+  if (left.IsInteger() && right.IsInteger()) {
+    return executeIntegerOperation(op, left, right);
+  }
+  ObjectType leftType = left.Type();
+  ObjectType rightType = right.Type();
+  if (leftType == STRING_OBJ && rightType == STRING_OBJ) {
+    return executeStringOperation(op, left, right);
+  } else if (left == __NULL || right == __NULL) {
+    return __NULL;
+  } else if (leftType != rightType) {
+    return new Error("type mismatch: " + leftType + " " + operatorString(op) + " " + rightType);
+  } else if (op == OP_EQ) {
+    return left == right ? __TRUE : __FALSE;
+  } else if (op == OP_NE) {
+    return left != right ? __TRUE : __FALSE;
+  } else {
+    return new Error("unknown operator: " + leftType + " " + operatorString(op) + " " + rightType);
+  }
+}
+
+Value VM::executeBangOperator(Value right) {
+  if (right.IsBoolean() || right.IsNull())
+    return right == __TRUE ? __FALSE : __TRUE;
+  if (right.IsInteger())
+    return right.AsInteger() == 0 ? __TRUE : __FALSE;
+  return __FALSE;
+}
+
+Value VM::executeMinusOperator(Value right) {
+  if (right.IsInteger())
+    return Value::FromInteger(-right.AsInteger());
+  return new Error("unknown operator: -" + right.Type());
+}
+
+Value VM::executeIndexExpression(Value array, Value index) {
+  if (array.Is(ARRAY_OBJ) && index.IsInteger()) {
+    Array* elements = (Array*)array.AsObject();
+    int i = index.AsInteger();
+    if (i < 0 || i >= (int)elements->Length())
+      return new Error("index " + index.Inspect() + " out of range");
+    return elements->Get(i);
+  }
+  if (array.Is(STRING_OBJ) && index.IsInteger()) {
+    std::string& value = ((String*)array.AsObject())->value;
+    int i = index.AsInteger();
+    if (i < 0 || i >= (int)value.size())
+      return new Error("index " + index.Inspect() + " out of range");
+    return charString(value[i]);
+  }
+  if (array.Is(HASH_OBJ)) {  // a missing key gives NULL
+    if (!Hash::Hashable(index))
+      return new Error("unusable as hash key: " + index.Type());
+    Value value = ((Hash*)array.AsObject())->Get(index);
+    return value.IsUnbound() ? __NULL : value;
+  }
+  return new Error("index operator not supported: " + array.Type());
+}
+
+// the operands are still on the stack, so a copied key is safe from the
+// collector until it is in the table
+Value VM::executeSetIndex(Value array, Value index, Value val) {
+  if (array.Is(ARRAY_OBJ) && index.IsInteger()) {
+    Array* elements = (Array*)array.AsObject();
+    int i = index.AsInteger();
+    if (i < 0 || i >= (int)elements->Length())
+      return new Error("index " + index.Inspect() + " out of range");
+    gc.Forget(elements->Set(i, val));
+  } else if (array.Is(HASH_OBJ)) {
+    Value key = hashKey(index);
+    if (isError(key))
+      return key;
+    gc.Forget(((Hash*)array.AsObject())->Set(key, val));
+    gc.Remember(array, key);
+  } else {
+    return new Error("index assignment not supported: " + array.Type());
+  }
+  gc.Remember(array, val);
+  return __NULL;
+}
+
+// returns an error, or nullptr after the call has been set up
+Object* VM::callFunction(int argc) {
+  Value callee = stack[sp - 1 - argc];
+  if (callee.Is(BUILTIN_OBJ)) {
+    std::vector<Value> args(stack.begin() + sp - argc, stack.begin() + sp);
+    Value result = ((Builtin*)callee.AsObject())->function(args, gc);
+    if (isError(result))
+      return result.AsObject();
+    sp -= argc + 1;
+    push(result);
+    return nullptr;
+  }
+  if (!callee.Is(FUNCTION_OBJ))
+    return new Error("not a function: " + callee.Type());
+  Function* fn = (Function*)callee.AsObject();
+  std::vector<Identifier*>& parameters = fn->literal->parameters;
+  if ((int)parameters.size() != argc) {
+    return new Error("argument length(" + std::to_string(argc) +
+        ") not equal to parameter length ("
+        + std::to_string(parameters.size()) + ")");
+  }
+  if ((int)frames.size() > maxDepth)  // the main program has a frame too
+    return new Error("maximum call depth (" + std::to_string(maxDepth) + ") exceeded");
+  // the environment of the caller stays the outer one for the collector
+  Environment* env = frames.back().env->NewEnclosedEnvironment(fn->literal->scope);
+  frames.push_back(Frame{fn, &fn->compiled->code, 0, sp - argc, env});
+  bindArguments(fn, argc);
+  return nullptr;
+}
+
+// the arguments on top of the stack go to the environment of the frame on
+// top, after a fresh Cell for every variable the closures inside capture.
+// the frame is pushed first, so the collector sees what is allocated here.
+void VM::bindArguments(Function* fn, int argc) {
+  Environment* env = frames.back().env;
+  for (int slot : fn->literal->scope->cells)
+    env->slots[slot] = track(new Cell());
+  std::vector<Identifier*>& parameters = fn->literal->parameters;
+  for (int i = 0; i < argc; i++) {
+    stack[sp - argc + i] = unpin(stack[sp - argc + i]);
+    setVariable(parameters[i], stack[sp - argc + i]);
+  }
+}
+
+void VM::setVariable(Identifier* name, Value val) {
+  if (name->kind == GLOBAL_VARIABLE) {
+    globals->SetSlot(name->slot, val);
+  } else if (name->kind == LOCAL_VARIABLE) {
+    frames.back().env->SetSlot(name->slot, val);
+  } else {
+    Cell* cell = (Cell*)frames.back().env->slots[name->slot].AsObject();
+    gc.Forget(cell->value);
+    cell->value = val;
+    gc.Remember(cell, val);
+  }
+}
+
+// a variable read before it is bound, like x in let x = x + 1,
+// is the top level one of the same name, or a builtin
+Value VM::unboundVariable(const std::string& name) {
+  Value obj = globals->Get(name);
+  if (!obj.IsUnbound())
+    return obj;
+  auto it = builtin.find(name);
+  if (it != builtin.end())
+    return it->second;
+  return new Error("identifier not found: " + name);
+}
+
+// before &f = g changes f in place. the frames running f go on with a
+// copy, which keeps their upvalues and the arena of their bytecode, a
+// streamed statement may have held the last other reference to it.
+void VM::keepRunning(Value fn) {
+  if (!fn.Is(FUNCTION_OBJ))
+    return;
+  Function* copy = nullptr;
+  for (auto& frame : frames) {
+    if (frame.fn != fn.AsObject())
+      continue;
+    if (copy == nullptr) {
+      copy = ((Function*)fn.AsObject())->Copy();
+      gc.Add(copy);
+    }
+    frame.fn = copy;
+  }
+}
+
+// the upvalues are the cells of the running call, or its own upvalues
+Object* VM::newClosure(CompiledFunction* compiled) {
+  Function* fn = new Function(compiled->literal, compiled);
+  Frame& frame = frames.back();
+  for (auto& capture : compiled->literal->scope->captures) {
+    if (capture.local)
+      fn->upvalues.push_back(frame.env->slots[capture.index]);
+    else
+      fn->upvalues.push_back(frame.fn->upvalues[capture.index]);
+  }
+  return track(fn);
+}
+
+// return f(...) while f is running: the arguments are bound in the
+// environment of the running call, which has the same slots, and its
+// frame starts over. false for any other callee.
+bool VM::tailCall(int argc) {
+  Frame& frame = frames.back();
+  Value callee = stack[sp - 1 - argc];
+  if (frame.fn == nullptr || !callee.Is(FUNCTION_OBJ) ||
+      ((Function*)callee.AsObject())->literal != frame.fn->literal ||
+      (int)frame.fn->literal->parameters.size() != argc)
+    return false;
+  for (int i = -1; i < argc; i++)
+    stack[frame.basePointer + i] = stack[sp - argc + i];
+  sp = frame.basePointer + argc;
+  frame.fn = (Function*)callee.AsObject();  // another closure may have other upvalues
+  frame.ip = 0;
+  frame.env->slots.assign(frame.env->scope->names.size(), Value::Unbound());
+  bindArguments(frame.fn, argc);
+  return true;
+}
+
+/*
+ * public functions
+ */
+Value VM::Run(Environment* env) {
+  returned = false;
+  globals = env;
+  frames.push_back(Frame{nullptr, bytecode, 0, 0, env});
+  Bytecode* code = bytecode;
+  const uint8_t* ins = code->instructions.data();
+  int ip = 0;
+  while (true) {
+    Opcode op = ins[ip];
+    ip++;
+    switch (op) {
+    case OP_CONSTANT: {
+      push(code->constants[ReadOperand(ins + ip, 4)]);
+      ip += 4;
+      break;
+    }
+    case OP_STRING: {
+      push(track(new String(code->strings[ReadOperand(ins + ip, 4)])));
+      ip += 4;
+      break;
+    }
+    case OP_POP:
+      sp--;
+      break;
+    case OP_TRUE:
+      push(__TRUE);
+      break;
+    case OP_FALSE:
+      push(__FALSE);
+      break;
+    case OP_NULL:
+      push(__NULL);
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_EQ:
+    case OP_NE:
+    case OP_GT:
+    case OP_LT:
+    case OP_GE:
+    case OP_LE: {
+      Value right = stack[sp - 1];
+      Value left = stack[sp - 2];
+      Value result = executeBinaryOperation(op, left, right);
+      if (isError(result))
+        return unwind(result);
+      sp -= 2;
+      push(result);
+      break;
+    }
+    case OP_MINUS: {
+      Value result = executeMinusOperator(stack[sp - 1]);
+      if (isError(result))
+        return unwind(result);
+      stack[sp - 1] = result;
+      break;
+    }
+    case OP_BANG:
+      stack[sp - 1] = executeBangOperator(stack[sp - 1]);
+      break;
+    case OP_JUMP:
+      ip = ReadOperand(ins + ip, 4);
+      break;
+    case OP_JUMP_NOT_TRUTHY: {
+      int target = ReadOperand(ins + ip, 4);
+      ip += 4;
+      if (!isTruthy(pop()))
+        ip = target;
+      break;
+    }
+    case OP_GET_LOCAL: {
+      int slot = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Environment* env = frames.back().env;
+      Value obj = env->GetSlot(slot);
+      if (obj.IsUnbound() && isError(obj = unboundVariable(env->scope->names[slot])))
+        return unwind(obj);
+      push(obj);
+      break;
+    }
+    case OP_GET_GLOBAL: {
+      int slot = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Value obj = globals->GetSlot(slot);
+      if (obj.IsUnbound() && isError(obj = unboundVariable(globals->scope->names[slot])))
+        return unwind(obj);
+      push(obj);
+      break;
+    }
+    case OP_GET_CELL: {
+      int slot = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Environment* env = frames.back().env;
+      Value obj = ((Cell*)env->slots[slot].AsObject())->value;
+      if (obj.IsUnbound() && isError(obj = unboundVariable(env->scope->names[slot])))
+        return unwind(obj);
+      push(obj);
+      break;
+    }
+    case OP_GET_UPVALUE: {
+      int index = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Function* fn = frames.back().fn;
+      Value obj = ((Cell*)fn->upvalues[index].AsObject())->value;
+      if (obj.IsUnbound() && isError(obj = unboundVariable(fn->literal->scope->upvalues[index])))
+        return unwind(obj);
+      push(obj);
+      break;
+    }
+    case OP_SET_LOCAL:
+      stack[sp - 1] = unpin(stack[sp - 1]);
+      frames.back().env->SetSlot(ReadOperand(ins + ip, 4), pop());
+      ip += 4;
+      break;
+    case OP_SET_GLOBAL:
+      stack[sp - 1] = unpin(stack[sp - 1]);
+      globals->SetSlot(ReadOperand(ins + ip, 4), pop());
+      ip += 4;
+      break;
+    case OP_SET_CELL: {
+      stack[sp - 1] = unpin(stack[sp - 1]);
+      Cell* cell = (Cell*)frames.back().env->slots[ReadOperand(ins + ip, 4)].AsObject();
+      ip += 4;
+      gc.Forget(cell->value);
+      cell->value = pop();
+      gc.Remember(cell, cell->value);
+      break;
+    }
+    case OP_REF_LOCAL:
+    case OP_REF_GLOBAL: {
+      int slot = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Environment* env = op == OP_REF_LOCAL ? frames.back().env : globals;
+      if (slot < (int)env->slots.size()) {
+        gc.Forget(env->slots[slot]);  // a function may be changed in place
+        keepRunning(env->slots[slot]);
+      }
+      Value result = env->RefSetSlot(slot, stack[sp - 1]);
+      if (slot < (int)env->slots.size())
+        gc.Remember(env->slots[slot]);  // a function may have been changed in place
+      if (isError(result))
+        return unwind(result);
+      sp--;
+      break;
+    }
+    case OP_REF_CELL: {
+      int slot = ReadOperand(ins + ip, 4);
+      ip += 4;
+      Environment* env = frames.back().env;
+      Cell* cell = (Cell*)env->slots[slot].AsObject();
+      gc.Forget(cell->value);
+      keepRunning(cell->value);
+      Value result = Environment::RefSet(cell->value, stack[sp - 1], env->scope->names[slot]);
+      gc.Remember(cell, cell->value);
+      gc.Remember(cell->value);  // a function may have been changed in place
+      if (isError(result))
+        return unwind(result);
+      sp--;
+      break;
+    }
+    case OP_ARRAY: {
+      int n = ReadOperand(ins + ip, 4);
+      ip += 4;
+      for (int i = sp - n; i < sp; i++)
+        stack[i] = unpin(stack[i]);
+      std::vector<Value> elements(stack.begin() + sp - n, stack.begin() + sp);
+      Object* array = track(new Array(elements));
+      sp -= n;
+      push(array);
+      break;
+    }
+    case OP_HASH: {
+      int n = ReadOperand(ins + ip, 4);
+      ip += 4;
+      // the copies replace the operands, the stack keeps them alive
+      for (int i = sp - 2 * n; i < sp; i += 2) {
+        Value key = hashKey(stack[i]);
+        if (isError(key))
+          return unwind(key);
+        stack[i] = key;
+        stack[i + 1] = unpin(stack[i + 1]);
+      }
+      Hash* hash = new Hash();
+      for (int i = sp - 2 * n; i < sp; i += 2)
+        hash->Set(stack[i], stack[i + 1]);
+      sp -= 2 * n;
+      push(track(hash));
+      break;
+    }
+    case OP_INDEX: {
+      Value result = executeIndexExpression(stack[sp - 2], stack[sp - 1]);
+      if (isError(result))
+        return unwind(result);
+      sp -= 2;
+      push(result);
+      break;
+    }
+    case OP_SET_INDEX: {
+      stack[sp - 1] = unpin(stack[sp - 1]);
+      Value result = executeSetIndex(stack[sp - 3], stack[sp - 2], stack[sp - 1]);
+      if (isError(result))
+        return unwind(result);
+      sp -= 3;
+      break;
+    }
+    case OP_CLOSURE: {
+      CompiledFunction* compiled = (CompiledFunction*)code->constants[ReadOperand(ins + ip, 4)].AsObject();
+      ip += 4;
+      push(newClosure(compiled));
+      break;
+    }
+    case OP_TAIL_CALL:
+      if (tailCall(ReadOperand(ins + ip, 4))) {
+        ip = 0;
+        break;
+      }
+      // fall through
+    case OP_CALL: {
+      int argc = ReadOperand(ins + ip, 4);
+      ip += 4;
+      frames.back().ip = ip;
+      Object* err = callFunction(argc);
+      if (err != nullptr)
+        return unwind(err);
+      code = frames.back().code;
+      ins = code->instructions.data();
+      ip = frames.back().ip;
+      break;
+    }
+    case OP_RETURN_VALUE: {
+      Value result = pop();
+      if (frames.size() == 1) {
+        // not the return the compiler puts at the end of the main program
+        returned = ip < (int)code->instructions.size();
+        frames.pop_back();
+        return result;
+      }
+      Frame frame = frames.back();
+      frames.pop_back();
+      frame.env->Release();
+      sp = frame.basePointer - 1;
+      push(result);
+      code = frames.back().code;
+      ins = code->instructions.data();
+      ip = frames.back().ip;
+      break;
+    }
+    }
+  }
+}
+
+}  // namespace monkey
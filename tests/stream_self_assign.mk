@@ -0,0 +1,6 @@
+// &self = g while h is running drops the last other reference to the
+// code of h when the statement that defined it has been freed.
+// ./monkey --stream tests/stream_self_assign.mk and with --vm print 42 twice.
+let h = fn(self, g) { &self = g; let z = 40 + 2; print(z); z };
+let g = fn(a, b) { 5 };
+print(h(h, g));